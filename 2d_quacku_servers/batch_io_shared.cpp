@@ -0,0 +1,220 @@
+#include "batch_io_shared.hpp"
+
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#endif
+
+buffer_pool::~buffer_pool()
+{
+    for(std::vector<char>* buf : free_buffers)
+        delete buf;
+}
+
+std::vector<char>* buffer_pool::take()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        if(free_buffers.size() > 0)
+        {
+            std::vector<char>* buf = free_buffers.back();
+            free_buffers.pop_back();
+
+            return buf;
+        }
+    }
+
+    return new std::vector<char>(BATCH_IO_MAX_DATAGRAM);
+}
+
+void buffer_pool::give(std::vector<char>* buf)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        if((int)free_buffers.size() < max_free)
+        {
+            free_buffers.push_back(buf);
+            return;
+        }
+    }
+
+    delete buf;
+}
+
+recv_ring::recv_ring() : pool(std::make_shared<buffer_pool>())
+{
+    for(int i=0; i<BATCH_IO_RING_SIZE; i++)
+    {
+        buffers.push_back(make_buffer());
+    }
+
+    lengths.resize(BATCH_IO_RING_SIZE);
+    addrs.resize(BATCH_IO_RING_SIZE);
+}
+
+std::shared_ptr<std::vector<char>> recv_ring::make_buffer()
+{
+    std::shared_ptr<buffer_pool> owner = pool;
+
+    return std::shared_ptr<std::vector<char>>(pool->take(), [owner](std::vector<char>* buf)
+    {
+        owner->give(buf);
+    });
+}
+
+void recv_ring::reclaim(int i)
+{
+    if(buffers[i].use_count() > 1)
+        buffers[i] = make_buffer();
+
+    ///the last holder may have been on another thread, make sure their reads are done before we write
+    std::atomic_thread_fence(std::memory_order_acquire);
+}
+
+#ifdef __linux__
+int recv_ring::receive(udp_sock& sock)
+{
+    mmsghdr msgs[BATCH_IO_RING_SIZE];
+    iovec iovs[BATCH_IO_RING_SIZE];
+
+    memset(msgs, 0, sizeof(msgs));
+
+    for(int i=0; i<BATCH_IO_RING_SIZE; i++)
+    {
+        reclaim(i);
+
+        iovs[i].iov_base = buffers[i]->data();
+        iovs[i].iov_len = buffers[i]->size();
+
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+    }
+
+    int num = recvmmsg(sock.get(), msgs, BATCH_IO_RING_SIZE, MSG_DONTWAIT, nullptr);
+
+    if(num < 0)
+    {
+        if(errno != EAGAIN && errno != EWOULDBLOCK)
+            printf("recvmmsg error %i\n", errno);
+
+        return 0;
+    }
+
+    for(int i=0; i<num; i++)
+    {
+        lengths[i] = msgs[i].msg_len;
+    }
+
+    return num;
+}
+
+void datagram_batch::flush()
+{
+    if((int)msgs.size() < num_queued)
+    {
+        msgs.resize(num_queued);
+        iovs.resize(num_queued);
+    }
+
+    memset(msgs.data(), 0, sizeof(mmsghdr) * num_queued);
+
+    for(int i=0; i<num_queued; i++)
+    {
+        iovs[i].iov_base = queued[i].data.data();
+        iovs[i].iov_len = queued[i].data.size();
+
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &queued[i].store;
+        msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+    }
+
+    ///one call per run of datagrams on the same socket, the server only has the one
+    int start = 0;
+
+    while(start < num_queued)
+    {
+        int fd = queued[start].sock.get();
+        int end = start;
+
+        while(end < num_queued && queued[end].sock.get() == fd)
+            end++;
+
+        while(start < end)
+        {
+            int sent = sendmmsg(fd, &msgs[start], std::min(end - start, 1024), 0);
+
+            if(sent <= 0)
+            {
+                printf("sendmmsg error %i\n", errno);
+                break;
+            }
+
+            start += sent;
+        }
+
+        start = end;
+    }
+
+    num_queued = 0;
+}
+#else
+int recv_ring::receive(udp_sock& sock)
+{
+    int num = 0;
+
+    while(num < BATCH_IO_RING_SIZE && sock_readable(sock))
+    {
+        auto data = udp_receive_from(sock, &addrs[num]);
+
+        if(data.size() == 0)
+            break;
+
+        reclaim(num);
+
+        int len = std::min((int)data.size(), BATCH_IO_MAX_DATAGRAM);
+
+        memcpy(buffers[num]->data(), data.data(), len);
+
+        lengths[num] = len;
+
+        num++;
+    }
+
+    return num;
+}
+
+void datagram_batch::flush()
+{
+    for(int i=0; i<num_queued; i++)
+    {
+        udp_send_to(queued[i].sock, queued[i].data, (const sockaddr*)&queued[i].store);
+    }
+
+    num_queued = 0;
+}
+#endif
+
+void datagram_batch::add(const udp_sock& sock, const sockaddr_storage& store, const char* data, int len)
+{
+    if(num_queued >= (int)queued.size())
+        queued.emplace_back();
+
+    pending& p = queued[num_queued];
+
+    p.sock = sock;
+    p.store = store;
+    p.data.assign(data, data + len);
+
+    num_queued++;
+}
@@ -0,0 +1,136 @@
+#ifndef BATCH_IO_SHARED_HPP_INCLUDED
+#define BATCH_IO_SHARED_HPP_INCLUDED
+
+#include <net/shared.hpp>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <stdint.h>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+///on linux these drain/fill a socket with one recvmmsg/sendmmsg per batch
+///everywhere else they fall back to a datagram at a time, same interface
+#define BATCH_IO_MAX_DATAGRAM 65536
+#define BATCH_IO_RING_SIZE 32
+
+///receive buffers nobody's holding any more, handed back from whichever thread let go of them last
+///so once we've warmed up, swapping a buffer out of the ring doesn't allocate (or zero 64KB)
+struct buffer_pool
+{
+    std::mutex lock;
+    std::vector<std::vector<char>*> free_buffers;
+
+    ///beyond this they get freed, so a burst doesn't pin memory forever
+    int max_free = 256;
+
+    ~buffer_pool();
+
+    ///a buffer of BATCH_IO_MAX_DATAGRAM, only allocates if nothing's been handed back
+    std::vector<char>* take();
+    void give(std::vector<char>* buf);
+};
+
+///pre allocated receive buffers, reused every batch
+///buffers are shared_ptrs so packet_views can keep a datagram alive after the ring moves on
+///a slot whose buffer is still referenced elsewhere gets another one from the pool rather than being overwritten
+///the old one goes back in the pool when its last view is dropped
+struct recv_ring
+{
+    std::vector<std::shared_ptr<std::vector<char>>> buffers;
+    std::vector<int> lengths;
+    std::vector<sockaddr_storage> addrs;
+
+    ///shared with the buffers' deleters, so it outlives the ring if views do
+    std::shared_ptr<buffer_pool> pool;
+
+    recv_ring();
+
+    std::shared_ptr<std::vector<char>> make_buffer();
+
+    ///number of datagrams received, slots [0, n) are valid
+    ///0 if nothing was waiting
+    int receive(udp_sock& sock);
+
+    const char* data(int i) const
+    {
+        return buffers[i]->data();
+    }
+
+    ///makes sure nobody else is holding on to slot i before we write into it
+    void reclaim(int i);
+};
+
+///everything going out this tick, sent in as few syscalls as we can manage on flush
+///entries keep their storage between flushes, so a steady state tick doesn't allocate
+struct datagram_batch
+{
+    struct pending
+    {
+        udp_sock sock;
+        sockaddr_storage store;
+        std::vector<char> data;
+    };
+
+    std::vector<pending> queued;
+    int num_queued = 0;
+
+    #ifdef __linux__
+    ///sendmmsg's view of queued, grown alongside it and rebuilt each flush
+    std::vector<mmsghdr> msgs;
+    std::vector<iovec> iovs;
+    #endif
+
+    void add(const udp_sock& sock, const sockaddr_storage& store, const char* data, int len);
+
+    void add(const udp_sock& sock, const sockaddr_storage& store, const std::vector<char>& data)
+    {
+        add(sock, store, data.data(), data.size());
+    }
+
+    void flush();
+};
+
+///for keying hash maps by address, eg looking up who sent a packet without scanning every player
+struct sockaddr_hash
+{
+    size_t operator()(const sockaddr_storage& store) const
+    {
+        uint64_t h = store.ss_family;
+
+        if(store.ss_family == AF_INET)
+        {
+            const sockaddr_in* in = (const sockaddr_in*)&store;
+
+            h = (h << 16) ^ in->sin_port;
+            h = (h << 32) ^ in->sin_addr.s_addr;
+        }
+        else if(store.ss_family == AF_INET6)
+        {
+            const sockaddr_in6* in = (const sockaddr_in6*)&store;
+
+            h = (h << 16) ^ in->sin6_port;
+
+            const uint8_t* bytes = (const uint8_t*)&in->sin6_addr;
+
+            for(int i=0; i < (int)sizeof(in->sin6_addr); i++)
+                h = (h * 1099511628211ull) ^ bytes[i];
+        }
+
+        return std::hash<uint64_t>()(h);
+    }
+};
+
+struct sockaddr_equal
+{
+    bool operator()(const sockaddr_storage& s1, const sockaddr_storage& s2) const
+    {
+        return s1 == s2;
+    }
+};
+
+#endif // BATCH_IO_SHARED_HPP_INCLUDED
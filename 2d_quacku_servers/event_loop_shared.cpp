@@ -0,0 +1,237 @@
+#include "event_loop_shared.hpp"
+
+#include <stdio.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+///epoll data is the index, with the top bit set for timers
+static constexpr uint64_t timer_bit = 1ull << 63;
+
+event_loop::event_loop()
+{
+    epoll_fd = epoll_create1(0);
+
+    if(epoll_fd < 0)
+        printf("epoll_create1 error %i\n", errno);
+}
+
+event_loop::~event_loop()
+{
+    for(timer& t : timers)
+    {
+        if(t.fd >= 0)
+            close(t.fd);
+    }
+
+    if(epoll_fd >= 0)
+        close(epoll_fd);
+}
+
+void event_loop::add_socket(const udp_sock& sock, std::function<void()> func)
+{
+    watched_socket ws;
+    ws.sock = sock;
+    ws.func = func;
+
+    sockets.push_back(ws);
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+
+    ev.events = EPOLLIN;
+    ev.data.u64 = sockets.size() - 1;
+
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock.get(), &ev) < 0)
+        printf("epoll_ctl socket error %i\n", errno);
+}
+
+///a zero it_value disarms the timer
+static void set_timerfd(int fd, float interval_ms, bool armed)
+{
+    itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+
+    if(armed)
+    {
+        int64_t interval_ns = (int64_t)(interval_ms * 1000 * 1000);
+
+        if(interval_ns <= 0)
+            interval_ns = 1;
+
+        spec.it_interval.tv_sec = interval_ns / 1000000000;
+        spec.it_interval.tv_nsec = interval_ns % 1000000000;
+        spec.it_value = spec.it_interval;
+    }
+
+    if(timerfd_settime(fd, 0, &spec, nullptr) < 0)
+        printf("timerfd_settime error %i\n", errno);
+}
+
+int event_loop::add_timer(float interval_ms, std::function<void()> func)
+{
+    timer t;
+    t.interval_ms = interval_ms;
+    t.func = func;
+    t.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if(t.fd < 0)
+    {
+        printf("timerfd_create error %i\n", errno);
+        return -1;
+    }
+
+    set_timerfd(t.fd, interval_ms, true);
+
+    timers.push_back(t);
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+
+    ev.events = EPOLLIN;
+    ev.data.u64 = (timers.size() - 1) | timer_bit;
+
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, t.fd, &ev) < 0)
+        printf("epoll_ctl timer error %i\n", errno);
+
+    return timers.size() - 1;
+}
+
+void event_loop::set_timer_armed(int id, bool armed)
+{
+    if(id < 0 || id >= (int)timers.size())
+        return;
+
+    timer& t = timers[id];
+
+    if(t.armed == armed)
+        return;
+
+    t.armed = armed;
+
+    ///settime also clears any expiry we haven't read yet, so a disarmed timer can't fire late
+    set_timerfd(t.fd, t.interval_ms, armed);
+}
+
+void event_loop::run_once(int max_wait_ms)
+{
+    epoll_event events[64];
+
+    int num = epoll_wait(epoll_fd, events, 64, max_wait_ms);
+
+    if(num < 0)
+    {
+        if(errno != EINTR)
+            printf("epoll_wait error %i\n", errno);
+
+        return;
+    }
+
+    for(int i=0; i<num; i++)
+    {
+        uint64_t data = events[i].data.u64;
+
+        if(data & timer_bit)
+        {
+            timer& t = timers[data & ~timer_bit];
+
+            ///if we fell behind, run once rather than once per missed expiry
+            uint64_t expirations = 0;
+
+            if(read(t.fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+                continue;
+
+            t.func();
+        }
+        else
+        {
+            sockets[data].func();
+        }
+    }
+
+    if(num > 0 && after_dispatch)
+        after_dispatch();
+}
+#else
+event_loop::event_loop()
+{
+
+}
+
+event_loop::~event_loop()
+{
+
+}
+
+void event_loop::add_socket(const udp_sock& sock, std::function<void()> func)
+{
+    watched_socket ws;
+    ws.sock = sock;
+    ws.func = func;
+
+    sockets.push_back(ws);
+}
+
+int event_loop::add_timer(float interval_ms, std::function<void()> func)
+{
+    timer t;
+    t.interval_ms = interval_ms;
+    t.func = func;
+
+    timers.push_back(t);
+
+    return timers.size() - 1;
+}
+
+void event_loop::set_timer_armed(int id, bool armed)
+{
+    if(id < 0 || id >= (int)timers.size())
+        return;
+
+    timer& t = timers[id];
+
+    if(t.armed == armed)
+        return;
+
+    t.armed = armed;
+    t.clk.restart();
+}
+
+///max_wait_ms is ignored, we never sleep longer than a millisecond here anyway
+void event_loop::run_once(int max_wait_ms)
+{
+    bool any = false;
+
+    for(watched_socket& ws : sockets)
+    {
+        if(sock_readable(ws.sock))
+        {
+            ws.func();
+            any = true;
+        }
+    }
+
+    for(timer& t : timers)
+    {
+        if(!t.armed)
+            continue;
+
+        if(t.clk.getElapsedTime().asMicroseconds() / 1000.f >= t.interval_ms)
+        {
+            t.clk.restart();
+            t.func();
+            any = true;
+        }
+    }
+
+    if(any && after_dispatch)
+        after_dispatch();
+
+    if(!any)
+        sf::sleep(sf::milliseconds(1));
+}
+#endif
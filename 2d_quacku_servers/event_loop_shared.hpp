@@ -0,0 +1,68 @@
+#ifndef EVENT_LOOP_SHARED_HPP_INCLUDED
+#define EVENT_LOOP_SHARED_HPP_INCLUDED
+
+#include <net/shared.hpp>
+#include <SFML/System.hpp>
+#include <functional>
+#include <vector>
+#include <stdint.h>
+
+///sleeps until a socket is readable or a timer is due, then runs whatever's ready
+///on linux that's epoll + a timerfd per timer, so an idle server doesn't wake up at all between timers
+///everywhere else it falls back to polling every millisecond, which is what the servers used to do
+struct event_loop
+{
+    struct timer
+    {
+        float interval_ms = 0;
+        std::function<void()> func;
+
+        int fd = -1;
+        sf::Clock clk;
+
+        bool armed = true;
+    };
+
+    struct watched_socket
+    {
+        udp_sock sock;
+        std::function<void()> func;
+    };
+
+    std::vector<timer> timers;
+    std::vector<watched_socket> sockets;
+
+    ///runs after each wakeup, once everything that woke us has been dispatched. Eg flushing sends
+    std::function<void()> after_dispatch;
+
+    bool going = true;
+
+    int epoll_fd = -1;
+
+    event_loop();
+    ~event_loop();
+
+    event_loop(const event_loop&) = delete;
+    event_loop& operator=(const event_loop&) = delete;
+
+    ///func should drain the socket, it'll get called again if there's anything left
+    void add_socket(const udp_sock& sock, std::function<void()> func);
+
+    ///first fires interval_ms from now, returns an id for set_timer_armed or -1
+    int add_timer(float interval_ms, std::function<void()> func);
+
+    ///a disarmed timer never wakes us up. Rearming starts the interval again from now
+    ///cheap to call every wakeup, it only touches the timer when the state changes
+    void set_timer_armed(int id, bool armed);
+
+    ///max_wait_ms -1 waits as long as it takes
+    void run_once(int max_wait_ms = -1);
+
+    void run()
+    {
+        while(going)
+            run_once();
+    }
+};
+
+#endif // EVENT_LOOP_SHARED_HPP_INCLUDED
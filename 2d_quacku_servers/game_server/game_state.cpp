@@ -1,42 +1,53 @@
 #include "game_state.hpp"
 #include "../master_server/network_messages.hpp"
 #include "../packet_clumping_shared.hpp"
+#include "../wire_protocol_shared.hpp"
 
+///every 4ms, off a timer that's only armed while has_pending
 void server_reliability_manager::tick(server_game_state* state)
 {
-    const float broadcast_time_ms = 4;
-
-    static sf::Clock clk;
-
-    if(clk.getElapsedTime().asMilliseconds() < broadcast_time_ms)
-        return;
-
-    clk.restart();
-
     for(auto& i : player_reliability_handler)
     {
         int32_t id = i.first;
 
-        player play = state->get_player_from_player_id(id);
+        player* play = state->get_player_from_player_id(id);
+
+        if(play == nullptr)
+            continue;
 
-        i.second.tick(play.sock, play.store);
+        i.second.tick(play->sock, play->store);
     }
 }
 
-void server_reliability_manager::add(byte_vector& vec, int32_t to_skip, uint32_t reliable_id)
+///only relayed to players on the sender's version, see process_received_message
+void server_reliability_manager::add(byte_vector& vec, int32_t to_skip, uint32_t reliable_id, uint8_t protocol_version)
 {
     for(auto& i : player_reliability_handler)
     {
         if(i.first == to_skip)
             continue;
 
+        if(i.second.protocol_version != protocol_version)
+            continue;
+
         i.second.add(vec, reliable_id);
     }
 }
 
-void server_reliability_manager::add_player(int32_t id)
+bool server_reliability_manager::has_pending() const
 {
-    player_reliability_handler[id];
+    for(auto& i : player_reliability_handler)
+    {
+        if(i.second.has_pending())
+            return true;
+    }
+
+    return false;
+}
+
+void server_reliability_manager::add_player(int32_t id, uint8_t protocol_version)
+{
+    player_reliability_handler[id].protocol_version = protocol_version;
 }
 
 void server_reliability_manager::remove_player(int32_t id)
@@ -79,7 +90,7 @@ void server_reliability_manager::add_packetid_to_ack(uint32_t reliable_id, int32
     }
 }
 
-void server_game_state::add_player(udp_sock& sock, sockaddr_storage store)
+void server_game_state::add_player(udp_sock& sock, sockaddr_storage store, uint8_t protocol_version)
 {
     int id = gid++;
 
@@ -92,10 +103,17 @@ void server_game_state::add_player(udp_sock& sock, sockaddr_storage store)
     play.id = id;
     play.sock = sock;
     play.store = store;
+    play.protocol_version = protocol_version;
 
     player_list.push_back(play);
 
-    reliable.add_player(id);
+    int32_t pos = player_list.size() - 1;
+
+    player_pos_by_id[id] = pos;
+    ///if they rejoined from the same address, the old entry keeps the address until it times out
+    player_pos_by_addr.emplace(store, pos);
+
+    reliable.add_player(id, protocol_version);
 }
 
 int16_t server_game_state::get_new_id()
@@ -122,41 +140,62 @@ int server_game_state::number_of_team(int team_id)
 
 int32_t server_game_state::get_team_from_player_id(int32_t id)
 {
-    for(auto& i : player_list)
-    {
-        if(i.id == id)
-            return i.team;
-    }
+    player* play = get_player_from_player_id(id);
 
-    return -1;
+    if(play == nullptr)
+        return -1;
+
+    return play->team;
 }
 
-player server_game_state::get_player_from_player_id(int32_t id)
+player* server_game_state::get_player_from_player_id(int32_t id)
 {
-    for(auto& i : player_list)
-    {
-        if(i.id == id)
-            return i;
-    }
+    int32_t pos = get_pos_from_player_id(id);
 
-    return player();
+    if(pos < 0)
+        return nullptr;
+
+    return &player_list[pos];
+}
+
+player* server_game_state::get_player_from_sockaddr(const sockaddr_storage& who)
+{
+    auto it = player_pos_by_addr.find(who);
+
+    if(it == player_pos_by_addr.end())
+        return nullptr;
+
+    return &player_list[it->second];
 }
 
 int32_t server_game_state::get_pos_from_player_id(int32_t id)
 {
-    //for(auto& i : player_list)
+    auto it = player_pos_by_id.find(id);
+
+    if(it == player_pos_by_id.end())
+        return -1;
+
+    return it->second;
+}
+
+///first entry for an address wins, same as the old linear scan
+void server_game_state::rebuild_player_index()
+{
+    player_pos_by_id.clear();
+    player_pos_by_addr.clear();
+
     for(int i=0; i<player_list.size(); i++)
     {
-        if(player_list[i].id == id)
-            return i;
+        player_pos_by_id[player_list[i].id] = i;
+        player_pos_by_addr.emplace(player_list[i].store, i);
     }
-
-    return -1;
 }
 
 ///need to heartbeat
 void server_game_state::cull_disconnected_players()
 {
+    bool any_culled = false;
+
     for(int i=0; i<player_list.size(); i++)
     {
         if(player_list[i].time_since_last_message.getElapsedTime().asMicroseconds() / 1000.f > timeout_time_ms)
@@ -168,8 +207,14 @@ void server_game_state::cull_disconnected_players()
 
             player_list.erase(player_list.begin() + i);
             i--;
+
+            any_culled = true;
         }
     }
+
+    ///leaving is rare, so just redo the lot
+    if(any_culled)
+        rebuild_player_index();
 }
 
 /*bool operator==(sockaddr_storage& s1, sockaddr_storage& s2)
@@ -186,13 +231,12 @@ void server_game_state::cull_disconnected_players()
 
 void server_game_state::reset_player_disconnect_timer(sockaddr_storage& store)
 {
-    for(auto& i : player_list)
-    {
-        if(i.store == store)
-        {
-            i.time_since_last_message.restart();
-        }
-    }
+    player* play = get_player_from_sockaddr(store);
+
+    if(play == nullptr)
+        return;
+
+    play->time_since_last_message.restart();
 }
 
 void server_game_state::set_map(int id)
@@ -219,17 +263,21 @@ void server_game_state::set_map(int id)
     }
 }
 
+void server_game_state::send_to(const player& play, const std::vector<char>& msgs)
+{
+    wire::frame(msgs.data(), msgs.size(), play.protocol_version, frame_scratch);
+
+    sends.add(play.sock, play.store, frame_scratch);
+}
+
 void server_game_state::broadcast(const std::vector<char>& dat, const int& to_skip)
 {
     for(int i=0; i<player_list.size(); i++)
     {
-        udp_sock& fd = player_list[i].sock;
-        sockaddr_storage store = player_list[i].store;
-
         if(i == to_skip)
             continue;
 
-        udp_send_to(fd, dat, (sockaddr*)&store);
+        send_to(player_list[i], dat);
     }
 }
 
@@ -239,30 +287,27 @@ void server_game_state::broadcast(const std::vector<char>& dat, sockaddr_storage
 
     for(int i=0; i<player_list.size(); i++)
     {
-        udp_sock& fd = player_list[i].sock;
-        sockaddr_storage store = player_list[i].store;
-
-        if(store == to_skip)
+        if(player_list[i].store == to_skip)
         {
             c++;
             continue;
         }
 
-        udp_send_to(fd, dat, (sockaddr*)&store);
+        send_to(player_list[i], dat);
     }
 
     if(c > 1)
         printf("ip conflict ");
 }
 
-void server_game_state::broadcast_clump(const std::vector<char>& dat, sockaddr_storage& to_skip)
+void server_game_state::broadcast_clump(int32_t type, const char* body, uint32_t len, sockaddr_storage& to_skip, uint8_t protocol_version)
 {
     int c = 0;
 
     for(int i=0; i<player_list.size(); i++)
     {
         udp_sock& fd = player_list[i].sock;
-        sockaddr_storage store = player_list[i].store;
+        const sockaddr_storage& store = player_list[i].store;
 
         if(store == to_skip)
         {
@@ -270,7 +315,10 @@ void server_game_state::broadcast_clump(const std::vector<char>& dat, sockaddr_s
             continue;
         }
 
-        packet_clump.add_send_data(fd, store, dat);
+        if(player_list[i].protocol_version != protocol_version)
+            continue;
+
+        packet_clump.add_message(fd, store, player_list[i].protocol_version, type, body, len);
     }
 
     if(c > 1)
@@ -328,7 +376,7 @@ void server_game_state::tick_all()
                 int32_t type = fetch.get<int32_t>();
 
                 if(type == message::FORWARDING)
-                    process_received_message(fetch, store);
+                    process_received_message(fetch, store, WIRE_VERSION_LEGACY);
             }
         }
     }
@@ -337,13 +385,12 @@ void server_game_state::tick_all()
 
 int32_t server_game_state::sockaddr_to_playerid(sockaddr_storage& who)
 {
-    for(auto& i : player_list)
-    {
-        if(i.store == who)
-            return i.id;
-    }
+    player* play = get_player_from_sockaddr(who);
 
-    return -1;
+    if(play == nullptr)
+        return -1;
+
+    return play->id;
 }
 
 ///do kill confirmer updates here
@@ -455,11 +502,11 @@ void server_game_state::tick()
     }
 }
 
-void server_game_state::process_received_message(byte_fetch& arg, sockaddr_storage& who)
+///the body is opaque to us, but its layout depends on the sender's version
+///legacy clients pack a 6 byte network_variable and raw vec2fs, version 2 an 8 byte one and quantised payloads
+///so it only goes to players on the same version. Legacy <-> legacy and v2 <-> v2, nothing is translated across
+void server_game_state::process_received_message(byte_fetch& arg, sockaddr_storage& who, uint8_t protocol_version)
 {
-    ///copy
-    byte_fetch fetch = arg;
-
     ///structure of a forwarding request
 
     ///canary ///already popped by calling function
@@ -489,37 +536,265 @@ void server_game_state::process_received_message(byte_fetch& arg, sockaddr_stora
         vec.push_back<uint8_t>(fetch.get<uint8_t>());
     }*/
 
-    byte_vector vec;
-    vec.push_back(canary_start);
+    ///the body goes out exactly as it came in, so we just check it and point at it
+    ///arg only moves on if it's good, same as when this worked on a copy
+    int start = arg.internal_counter;
 
-    vec.push_back(message::FORWARDING);
+    if(arg.ptr.size() < start + sizeof(uint32_t))
+        return;
 
-    uint32_t len = fetch.get<uint32_t>();
+    uint32_t len = 0;
+    memcpy(&len, &arg.ptr[start], sizeof(len));
 
     if(len > 255)
-        len = 255;
+    {
+        printf("forwarded message too long %u\n", len);
+        return;
+    }
 
-    vec.push_back<uint32_t>(len);
+    uint32_t body_len = sizeof(uint32_t) + len;
 
-    for(int i=0; i<len; i++)
+    if(arg.ptr.size() < start + body_len + sizeof(canary_end))
     {
-        vec.push_back(fetch.get<uint8_t>());
+        printf("forwarded message overruns packet\n");
+        return;
     }
 
-    vec.push_back(canary_end);
+    int32_t found_end = 0;
+    memcpy(&found_end, &arg.ptr[start + body_len], sizeof(found_end));
+
+    if(found_end != canary_end)
+    {
+        printf("canary mismatch in processed received message\n");
+        return;
+    }
+
+    arg.internal_counter = start + body_len + sizeof(canary_end);
+
+    broadcast_clump(message::FORWARDING, &arg.ptr[start], body_len, who, protocol_version);
+}
+
+namespace
+{
+    bool in_view(const player& play, vec2f pos, float margin)
+    {
+        return pos.x() >= play.view_tl.x() - margin && pos.y() >= play.view_tl.y() - margin &&
+               pos.x() <= play.view_br.x() + margin && pos.y() <= play.view_br.y() + margin;
+    }
+}
+
+///batches are already packed to FORWARDING_BATCH_MTU by the sender
+///each recipient gets the batch as is if they care about all of it, otherwise the entries they care about
+///entries are copied whole, never re-split
+///only version 2 clients send or understand batches, legacy players never get them
+void server_game_state::process_received_batch(byte_fetch& arg, sockaddr_storage& who)
+{
+    ///canary and type already popped
+    ///everything's checked and read where it sits, recipients get slices of it gathered straight into their datagrams
+    int start = arg.internal_counter;
+
+    const int header_size = sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint32_t);
+
+    if(arg.ptr.size() < start + header_size)
+    {
+        arg.internal_counter = arg.ptr.size();
+        return;
+    }
+
+    uint32_t data_size = 0;
+    uint16_t count = 0;
+    uint32_t sender_tick = 0;
+
+    memcpy(&data_size, &arg.ptr[start], sizeof(data_size));
+    memcpy(&count, &arg.ptr[start + sizeof(uint32_t)], sizeof(count));
+    memcpy(&sender_tick, &arg.ptr[start + sizeof(uint32_t) + sizeof(uint16_t)], sizeof(sender_tick));
+
+    int data_start = start + header_size;
+
+    if(data_start + (uint64_t)data_size + sizeof(canary_end) > arg.ptr.size())
+    {
+        printf("forwarding batch overruns datagram\n");
+
+        arg.internal_counter = arg.ptr.size();
+        return;
+    }
+
+    int32_t found_end = 0;
+    memcpy(&found_end, &arg.ptr[data_start + data_size], sizeof(found_end));
+
+    if(found_end != canary_end)
+    {
+        printf("canary mismatch in processed received batch\n");
+        return;
+    }
+
+    arg.internal_counter = data_start + data_size + sizeof(canary_end);
+
+    const char* data = &arg.ptr[data_start];
+
+    batch_entries.clear();
+
+    span_reader reader(data, data_size);
+
+    for(int i=0; i < count && !reader.finished(); i++)
+    {
+        forwarding_batch_entry entry;
+        entry.start = reader.counter;
+
+        network_variable nv = reader.get<network_variable>();
+
+        uint16_t len = reader.get<uint16_t>();
+
+        if(reader.counter + len > data_size)
+        {
+            printf("forwarding batch entry overruns batch\n");
+            return;
+        }
+
+        uint64_t key = ((uint64_t)(uint16_t)nv.player_id << 48) | ((uint64_t)(uint16_t)nv.system_network_id << 32) | nv.object_id;
+
+        replicated_object_track& track = object_tracks[key];
+
+        span_reader payload(data + reader.counter, len);
+
+        vec2f pos;
+
+        if(len > 0 && track.decoder.decode(payload, pos))
+        {
+            track.pos = pos;
+            track.have_pos = true;
+        }
+
+        track.updates++;
+        track.time_since_update.restart();
+
+        entry.have_pos = track.have_pos;
+        entry.pos = track.pos;
+        entry.always = !track.have_pos || (track.decoder.last_flags & (replication::KEYFRAME | replication::FORCED));
+        entry.far_update = (track.updates % far_update_interval) == 0;
+
+        reader.counter += len;
+
+        entry.len = reader.counter - entry.start;
+
+        batch_entries.push_back(entry);
+    }
+
+    ///the body as received, minus the trailing canary
+    body_slice whole;
+    whole.data = &arg.ptr[start];
+    whole.len = data_start + data_size - start;
+
+    ///filtered batches get a header of their own, then the entries they want
+    char filtered_header[header_size];
+
+    for(player& play : player_list)
+    {
+        if(play.store == who)
+            continue;
+
+        if(play.protocol_version != WIRE_VERSION)
+            continue;
+
+        if(!play.has_view)
+        {
+            packet_clump.add_message(play.sock, play.store, play.protocol_version, message::FORWARDING_BATCH, &whole, 1);
+            continue;
+        }
+
+        batch_slices.resize(1);
+
+        uint32_t filtered_size = 0;
+        int num_selected = 0;
+
+        for(const forwarding_batch_entry& entry : batch_entries)
+        {
+            if(!entry.always && !entry.far_update && !in_view(play, entry.pos, view_margin))
+                continue;
+
+            filtered_size += entry.len;
+            num_selected++;
+
+            body_slice& last = batch_slices.back();
+
+            ///neighbouring entries go out as one slice
+            if(batch_slices.size() > 1 && last.data + last.len == data + entry.start)
+            {
+                last.len += entry.len;
+                continue;
+            }
+
+            body_slice slice;
+            slice.data = data + entry.start;
+            slice.len = entry.len;
+
+            batch_slices.push_back(slice);
+        }
+
+        if(num_selected == 0)
+            continue;
+
+        if(num_selected == (int)batch_entries.size())
+        {
+            packet_clump.add_message(play.sock, play.store, play.protocol_version, message::FORWARDING_BATCH, &whole, 1);
+            continue;
+        }
+
+        uint16_t filtered_count = num_selected;
+
+        memcpy(&filtered_header[0], &filtered_size, sizeof(filtered_size));
+        memcpy(&filtered_header[sizeof(uint32_t)], &filtered_count, sizeof(filtered_count));
+        memcpy(&filtered_header[sizeof(uint32_t) + sizeof(uint16_t)], &sender_tick, sizeof(sender_tick));
+
+        batch_slices[0].data = filtered_header;
+        batch_slices[0].len = header_size;
+
+        packet_clump.add_message(play.sock, play.store, play.protocol_version, message::FORWARDING_BATCH, batch_slices.data(), batch_slices.size());
+    }
+}
+
+void server_game_state::process_view_report(byte_fetch& arg, sockaddr_storage& who)
+{
+    byte_fetch fetch = arg;
+
+    vec2f tl = fetch.get<vec2f>();
+    vec2f br = fetch.get<vec2f>();
 
     int32_t found_end = fetch.get<int32_t>();
 
-    ///rewind
     if(found_end != canary_end)
     {
-        printf("canary mismatch in processed received message\n");
+        printf("canary mismatch in view report\n");
         return;
     }
 
     arg = fetch;
 
-    broadcast_clump(vec.ptr, who);
+    player* play = get_player_from_sockaddr(who);
+
+    if(play == nullptr)
+        return;
+
+    play->has_view = true;
+    play->view_tl = tl;
+    play->view_br = br;
+}
+
+///objects don't tell us when they're gone, so forget anything we haven't heard about in a while
+void server_game_state::prune_object_tracks()
+{
+    if(track_prune_clk.getElapsedTime().asSeconds() < 5)
+        return;
+
+    track_prune_clk.restart();
+
+    for(auto it = object_tracks.begin(); it != object_tracks.end();)
+    {
+        if(it->second.time_since_update.getElapsedTime().asSeconds() > 10)
+            it = object_tracks.erase(it);
+        else
+            it++;
+    }
 }
 
 void server_game_state::process_reported_message(byte_fetch& arg, sockaddr_storage& who)
@@ -582,7 +857,7 @@ void server_game_state::process_reported_message(byte_fetch& arg, sockaddr_stora
     arg = fetch;
 }
 
-void server_game_state::process_join_request(udp_sock& my_server, byte_fetch& fetch, sockaddr_storage& who)
+void server_game_state::process_join_request(udp_sock& my_server, byte_fetch& fetch, sockaddr_storage& who, uint8_t protocol_version)
 {
     int32_t found_end = fetch.get<int32_t>();
 
@@ -591,7 +866,7 @@ void server_game_state::process_join_request(udp_sock& my_server, byte_fetch& fe
 
     printf("Player joined %s:%s\n", get_addr_ip(who).c_str(), get_addr_port(who).c_str());
 
-    add_player(my_server, who);
+    add_player(my_server, who, protocol_version);
     ///really need to pipe back player id
 
     int32_t new_player_id = player_list.back().id;
@@ -601,12 +876,11 @@ void server_game_state::process_join_request(udp_sock& my_server, byte_fetch& fe
     ///should really dynamically organise teams
     ///so actually that's what I'll do
     byte_vector vec;
-    vec.push_back(canary_start);
-    vec.push_back(message::CLIENTJOINACK);
+    size_t body = wire::begin(vec, message::CLIENTJOINACK);
     vec.push_back<int32_t>(new_player_id);
-    vec.push_back(canary_end);
+    wire::end(vec, body);
 
-    udp_send_to(my_server, vec.ptr, (const sockaddr*)&who);
+    send_to(player_list.back(), vec.ptr);
 
     printf("sending ack to pid %i\n", new_player_id);
 }
@@ -705,28 +979,19 @@ void server_game_state::ping()
     last_time_ms = running_time.getElapsedTime().asMicroseconds() / 1000.f;
 
     byte_vector vec;
-    vec.push_back(canary_start);
-    vec.push_back(message::PING);
-    vec.push_back(canary_end);
+    size_t body = wire::begin(vec, message::PING);
+    wire::end(vec, body);
 
     int none = -1;
 
     broadcast(vec.ptr, none);
 }
 
+///once a second, off a timer
 void server_game_state::broadcast_ping_data()
 {
-    static sf::Clock clk;
-    const float send_time_ms = 1000;
-
-    if(clk.getElapsedTime().asMicroseconds() / 1000.f < send_time_ms)
-        return;
-
-    clk.restart();
-
     byte_vector vec;
-    vec.push_back(canary_start);
-    vec.push_back(message::PING_DATA);
+    size_t body = wire::begin(vec, message::PING_DATA);
 
     int32_t num = player_list.size();
 
@@ -741,7 +1006,7 @@ void server_game_state::broadcast_ping_data()
         vec.push_back<float>(player_list[i].ping_ms);
     }
 
-    vec.push_back(canary_end);
+    wire::end(vec, body);
 
     int none = -1;
 
@@ -787,21 +1052,9 @@ void server_game_state::respawn_player(int32_t player_id)
 {
     int team_id = get_team_from_player_id(player_id);
 
-    bool found = false;
-
-    player play;
-
-    for(auto& i : player_list)
-    {
-        if(i.id == player_id)
-        {
-            play = i;
-
-            found = true;
-        }
-    }
+    player* play = get_player_from_player_id(player_id);
 
-    if(!found)
+    if(play == nullptr)
     {
         printf("No player with id %i\n", player_id);
         return;
@@ -818,12 +1071,11 @@ void server_game_state::respawn_player(int32_t player_id)
     ///a respawn until it gets one, and udp delivered whole
     ///except freak occurence
     byte_vector vec;
-    vec.push_back(canary_start);
-    vec.push_back(message::RESPAWNRESPONSE);
+    size_t body = wire::begin(vec, message::RESPAWNRESPONSE);
     vec.push_back(new_pos);
-    vec.push_back(canary_end);
+    wire::end(vec, body);
 
-    udp_send_to(play.sock, vec.ptr, (const sockaddr*)&play.store);
+    send_to(*play, vec.ptr);
 }
 
 void server_game_state::ensure_player_info_entry()
@@ -901,11 +1153,10 @@ void balance_first_to_x(server_game_state& state)
             ///network
 
             byte_vector vec;
-            vec.push_back(canary_start);
-            vec.push_back(message::TEAMASSIGNMENT);
+            size_t body = wire::begin(vec, message::TEAMASSIGNMENT);
             vec.push_back<int32_t>(i.id);
             vec.push_back<int32_t>(i.team);
-            vec.push_back(canary_end);
+            wire::end(vec, body);
 
             //udp_send_to(i.sock, vec.ptr, (const sockaddr*)&i.store);
 
@@ -949,11 +1200,10 @@ void balance_ffa(server_game_state& state)
             i.team = (i.team + 1) % TEAM_NUMS;
 
             byte_vector vec;
-            vec.push_back(canary_start);
-            vec.push_back(message::TEAMASSIGNMENT);
+            size_t body = wire::begin(vec, message::TEAMASSIGNMENT);
             vec.push_back<int32_t>(i.id);
             vec.push_back<int32_t>(i.team);
-            vec.push_back(canary_end);
+            wire::end(vec, body);
 
             int no_player = -1;
 
@@ -974,27 +1224,17 @@ void server_game_state::balance_teams()
         return balance_ffa(*this);
 }
 
+///once a second, off a timer
 void server_game_state::periodic_team_broadcast()
 {
-    static sf::Clock clk;
-
-    ///once per second
-    float broadcast_every_ms = 1000.f;
-
-    if(clk.getElapsedTime().asMicroseconds() / 1000.f < broadcast_every_ms)
-        return;
-
-    clk.restart();
-
     for(auto& i : player_list)
     {
         ///network
         byte_vector vec;
-        vec.push_back(canary_start);
-        vec.push_back(message::TEAMASSIGNMENT);
+        size_t body = wire::begin(vec, message::TEAMASSIGNMENT);
         vec.push_back<int32_t>(i.id);
         vec.push_back<int32_t>(i.team);
-        vec.push_back(canary_end);
+        wire::end(vec, body);
 
         //printf("Team ass %i team player %i\n", i.team, i.id);
 
@@ -1006,72 +1246,64 @@ void server_game_state::periodic_team_broadcast()
 
 void server_game_state::periodic_gamemode_stats_broadcast()
 {
-    static sf::Clock clk;
-
     ///once per second
     float broadcast_every_ms = 1000.f;
 
-    if(clk.getElapsedTime().asMicroseconds() / 1000.f < broadcast_every_ms)
+    if(gamemode_stats_clk.getElapsedTime().asMicroseconds() / 1000.f < broadcast_every_ms)
         return;
 
-    clk.restart();
+    gamemode_stats_clk.restart();
 
     byte_vector vec;
-    vec.push_back(canary_start);
-    vec.push_back(message::GAMEMODEUPDATE);
+    size_t body = wire::begin(vec, message::GAMEMODEUPDATE);
     vec.push_back(mode_handler.shared_game_state.current_game_mode);
 
     vec.push_back(mode_handler.shared_game_state.current_session_state);
     vec.push_back(mode_handler.shared_game_state.current_session_boundaries);
 
-    vec.push_back(canary_end);
+    wire::end(vec, body);
 
     broadcast(vec.ptr, -1);
 }
 
 void server_game_state::periodic_respawn_info_update()
 {
-    static sf::Clock clk;
-
     ///once per second
     float broadcast_every_ms = 100.f;
 
-    if(clk.getElapsedTime().asMicroseconds() / 1000.f < broadcast_every_ms)
+    if(respawn_info_clk.getElapsedTime().asMicroseconds() / 1000.f < broadcast_every_ms)
         return;
 
-    clk.restart();
+    respawn_info_clk.restart();
 
     for(auto& i : respawn_requests)
     {
-        player play = get_player_from_player_id(i.player_id);
+        player* play = get_player_from_player_id(i.player_id);
 
-        if(play.id == -1)
+        if(play == nullptr)
             continue;
 
         float time_elapsed = i.clk.getElapsedTime().asMicroseconds() / 1000.f;
 
         byte_vector vec;
-        vec.push_back(canary_start);
-        vec.push_back(message::RESPAWNINFO);
+        size_t body = wire::begin(vec, message::RESPAWNINFO);
         vec.push_back(time_elapsed);
         vec.push_back(i.time_to_respawn_ms);
-        vec.push_back(canary_end);
+        wire::end(vec, body);
 
-        udp_send_to(play.sock, vec.ptr, (const sockaddr*)&play.store);
+        send_to(*play, vec.ptr);
     }
 }
 
 void server_game_state::periodic_player_stats_update()
 {
-    static sf::Clock clk;
-
     ///once per second
     float broadcast_every_ms = 1000.f;
 
-    if(clk.getElapsedTime().asMicroseconds() / 1000.f < broadcast_every_ms)
+    if(player_stats_clk.getElapsedTime().asMicroseconds() / 1000.f < broadcast_every_ms)
         return;
 
-    clk.restart();
+    player_stats_clk.restart();
 
     for(auto& i : mode_handler.shared_game_state.player_info)
     {
@@ -1079,11 +1311,10 @@ void server_game_state::periodic_player_stats_update()
         player_info_shared info = i.second;
 
         byte_vector vec;
-        vec.push_back(canary_start);
-        vec.push_back<net_type::message_t>(message::PLAYER_STATS_UPDATE_INDIVIDUAL);
+        size_t body = wire::begin(vec, message::PLAYER_STATS_UPDATE_INDIVIDUAL);
         vec.push_back<net_type::player_t>(network_id);
         vec.push_back<player_info_shared>(info);
-        vec.push_back(canary_end);
+        wire::end(vec, body);
 
         int no_player = -1;
         broadcast(vec.ptr, no_player);
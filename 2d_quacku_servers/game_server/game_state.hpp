@@ -6,12 +6,16 @@
 
 #include <set>
 #include <map>
+#include <unordered_map>
 
 #include "game_modes.hpp"
 
 #include "../reliability_shared.hpp"
 #include "../packet_clumping_shared.hpp"
 #include "../game_mode_shared.hpp"
+#include "../replication_shared.hpp"
+#include "../batch_io_shared.hpp"
+#include "../wire_protocol_shared.hpp"
 
 struct player
 {
@@ -35,6 +39,41 @@ struct player
     udp_sock sock;
     sockaddr_storage store;
     sf::Clock time_since_last_message;
+
+    ///what they joined with, everything we send them is framed to match
+    uint8_t protocol_version = WIRE_VERSION;
+
+    ///from VIEW_REPORT, until we get one everything gets forwarded to them
+    bool has_view = false;
+    vec2f view_tl = {0,0};
+    vec2f view_br = {0,0};
+};
+
+///last known position of something a client is replicating, pulled out of the position block
+///keyed by (player_id, system_network_id, object_id)
+struct replicated_object_track
+{
+    replication::position_decoder decoder;
+
+    bool have_pos = false;
+    vec2f pos = {0,0};
+
+    uint32_t updates = 0;
+    sf::Clock time_since_update;
+};
+
+///one entry of a FORWARDING_BATCH, as offsets into the received batch
+struct forwarding_batch_entry
+{
+    int start = 0;
+    int len = 0;
+
+    bool have_pos = false;
+    vec2f pos = {0,0};
+
+    ///keyframes and forced updates, or anything we couldn't place
+    bool always = true;
+    bool far_update = false;
 };
 
 ///modify this to have player_id_reported_as_killer
@@ -78,13 +117,15 @@ struct server_reliability_manager
 
     void tick(server_game_state* state);
 
-    void add(byte_vector& vec, int32_t to_skip, uint32_t reliable_id);
+    void add(byte_vector& vec, int32_t to_skip, uint32_t reliable_id, uint8_t protocol_version);
     void add_packetid_to_ack(uint32_t id, int32_t to_whom);
 
-    void add_player(int32_t id);
+    void add_player(int32_t id, uint8_t protocol_version);
     void remove_player(int32_t id);
 
     void process_ack(byte_fetch& fetch);
+
+    bool has_pending() const;
 };
 
 ///so, we want to pipe everyone's ping to everyone else
@@ -96,6 +137,10 @@ struct server_game_state
 {
     packet_clumper packet_clump;
 
+    ///per player traffic for this loop iteration, flushed once at the end
+    datagram_batch sends;
+    std::vector<char> frame_scratch;
+
     server_reliability_manager reliable;
 
     int max_players = 10;
@@ -117,7 +162,6 @@ struct server_game_state
 
     float timeout_time_ms = 10000;
     float ping_interval_ms = 1000;
-    sf::Clock ping_interval_clk;
     float last_time_ms = 0;
     sf::Clock running_time;
 
@@ -125,18 +169,47 @@ struct server_game_state
     ///PLAYER IDS ARE NOT POSITIONS IN THIS STRUCTURE
     std::vector<player> player_list;
 
+    ///position in player_list by id and by address, so per message lookups don't scale with player count
+    ///only add_player and cull_disconnected_players change player_list, and they keep these in step
+    std::unordered_map<int32_t, int32_t> player_pos_by_id;
+    std::unordered_map<sockaddr_storage, int32_t, sockaddr_hash, sockaddr_equal> player_pos_by_addr;
+
+    void rebuild_player_index();
+
+    std::unordered_map<uint64_t, replicated_object_track> object_tracks;
+    sf::Clock track_prune_clk;
+
+    ///per state, not static, so that several sessions in one process each keep their own schedule
+    sf::Clock gamemode_stats_clk;
+    sf::Clock respawn_info_clk;
+    sf::Clock player_stats_clk;
+
+    ///objects outside a player's view (plus margin) only get every nth update forwarded to them
+    ///keyframes and forced updates always go through
+    int far_update_interval = 8;
+    float view_margin = 400.f;
+
+    ///process_received_batch's working space, kept so relaying a batch doesn't allocate
+    std::vector<forwarding_batch_entry> batch_entries;
+    std::vector<body_slice> batch_slices;
+
     int number_of_team(int team_id);
 
     int32_t get_team_from_player_id(int32_t id);
-    player get_player_from_player_id(int32_t id);
+    ///nullptr if they're not here. Valid until the next player joins or gets culled
+    player* get_player_from_player_id(int32_t id);
+    player* get_player_from_sockaddr(const sockaddr_storage& who);
     int32_t get_pos_from_player_id(int32_t id);
 
+    ///dat is version 2 messages with no datagram header, see wire_protocol_shared.hpp
+    void send_to(const player& play, const std::vector<char>& msgs);
     void broadcast(const std::vector<char>& dat, const int& to_skip);
     void broadcast(const std::vector<char>& dat, sockaddr_storage& to_skip);
-    void broadcast_clump(const std::vector<char>& dat, sockaddr_storage& to_skip);
+    ///one message, body copied straight into each player's clump buffer
+    void broadcast_clump(int32_t type, const char* body, uint32_t len, sockaddr_storage& to_skip, uint8_t protocol_version);
 
     void cull_disconnected_players();
-    void add_player(udp_sock& sock, sockaddr_storage store);
+    void add_player(udp_sock& sock, sockaddr_storage store, uint8_t protocol_version);
     int16_t get_new_id();
 
     ///for the moment just suck at it
@@ -147,9 +220,12 @@ struct server_game_state
 
     void tick();
 
-    void process_received_message(byte_fetch& fetch, sockaddr_storage& who);
+    void process_received_message(byte_fetch& fetch, sockaddr_storage& who, uint8_t protocol_version);
+    void process_received_batch(byte_fetch& fetch, sockaddr_storage& who);
+    void process_view_report(byte_fetch& fetch, sockaddr_storage& who);
+    void prune_object_tracks();
     void process_reported_message(byte_fetch& fetch, sockaddr_storage& who);
-    void process_join_request(udp_sock& sock, byte_fetch& fetch, sockaddr_storage& who);
+    void process_join_request(udp_sock& sock, byte_fetch& fetch, sockaddr_storage& who, uint8_t protocol_version);
     void process_respawn_request(udp_sock& sock, byte_fetch& fetch, sockaddr_storage& who);
     //void process_ping_and_forward(udp_sock& sock, byte_fetch& fetch, sockaddr_storage& who);
     void process_ping_response(udp_sock& sock, byte_fetch& fetch, sockaddr_storage& who);
@@ -5,287 +5,457 @@
 #include "../master_server/network_messages.hpp"
 #include <vec/vec.hpp>
 #include "game_state.hpp"
+#include "../profiler_shared.hpp"
+#include "../batch_io_shared.hpp"
+#include "../wire_protocol_shared.hpp"
+#include "../event_loop_shared.hpp"
+
+#include <thread>
+#include <memory>
+#include <algorithm>
 
 #include <cl/cl.h>
 
-///The code duplication and poor organisation is unreal. We need a cleanup :[
-void tcp_periodic_connect(tcp_sock& sock, const std::string& address)
+///once a second, off a timer
+void ping_master(server_game_state& my_state, int32_t port, udp_sock& to_master)
 {
-    if(sock.valid())
-        return;
+    if(!to_master.valid())
+    {
+        if(to_master.udp_connected)
+        {
+            to_master.close();
+            printf("Local sock error (this is not caused by master server termination), reopening socket");
+        }
+
+        to_master = udp_connect(MASTER_IP, MASTER_PORT);
+
+        printf("Creating socket to master server\n");
+    }
 
-    static sock_info inf;
+    byte_vector vec;
 
-    static bool first = true; ///tries once the first time, every time
+    vec.push_back<int32_t>(my_state.player_list.size());
+    vec.push_back<int32_t>(port);
 
-    const int delay_s = 5;
+    udp_send(to_master, vec.ptr);
+}
 
-    if(inf.valid())
+///fetch is positioned just after the type, and the body is followed by canary_end whichever version it came in as
+void dispatch_message(server_game_state& my_state, udp_sock& my_server, int32_t type, byte_fetch& fetch, sockaddr_storage& store, uint8_t protocol_version)
+{
+    if(type == message::CLIENTJOINREQUEST)
     {
-        std::cout << "Connected to tcp server @ " << address << std::endl;
+        my_state.process_join_request(my_server, fetch, store, protocol_version);
+    }
 
-        sock = tcp_sock(inf.get());
-        return;
+    else if(type == message::FORWARDING)
+    {
+        my_state.process_received_message(fetch, store, protocol_version);
     }
 
-    ///If the last connection attempt has timed out, retry
-    if(!inf.within_timeout() || first)
+    else if(type == message::FORWARDING_BATCH)
+    {
+        my_state.process_received_batch(fetch, store);
+    }
+    else if(type == message::VIEW_REPORT)
+    {
+        my_state.process_view_report(fetch, store);
+    }
+    else if(type == message::REPORT)
     {
-        printf("Attempting connection to server\n");
+        my_state.process_reported_message(fetch, store);
+    }
+    else if(type == message::RESPAWNREQUEST)
+    {
+        my_state.process_respawn_request(my_server, fetch, store);
+    }
+    else if(type == message::FORWARDING_RELIABLE)
+    {
+        int32_t player_id = my_state.sockaddr_to_playerid(store);
 
-        inf = tcp_connect(address, delay_s, 0);
+        uint32_t reliable_id = -1;
 
-        first = false;
+        byte_vector vec = reliability_manager::strip_data_from_forwarding_reliable(fetch, reliable_id);
+
+        ///don't want to replicate it back to the player, do we!
+        ///we're calling add, but add sticks on canaries
+        ///really we want to strip down the message
+
+        ///so uuh. this is instructing the server to just repeatdly forward
+        ///the message to the client
+        ///whereas obviously we want to check if they've already got it
+        ///I'm not smart
+        my_state.reliable.add(vec, player_id, reliable_id, protocol_version);
+        my_state.reliable.add_packetid_to_ack(reliable_id, player_id);
+    }
+    else if(type == message::FORWARDING_RELIABLE_ACK)
+    {
+        my_state.reliable.process_ack(fetch);
+    }
+    else if(type == message::PING_RESPONSE)
+    {
+        my_state.process_ping_response(my_server, fetch, store);
+    }
+    else if(type == message::PING_GAMESERVER)
+    {
+        my_state.process_ping_gameserver(my_server, fetch, store);
+    }
+    else
+    {
+        printf("err %i ", type);
     }
-}
 
-sock_info try_tcp_connect(const std::string& address, const std::string& port)
-{
-    sock_info inf;
+    /*if(!once && my_state.gid == 3)
+    {
+        printf("pied piping\n");
 
-    inf = tcp_connect(address, port, 1, 0);
+        //my_state.reliable.add(test, -1);
 
-    return inf;
+        once = true;
+    }*/
+
+    //printf("client %s:%s\n", get_addr_ip(store).c_str(), get_addr_port(store).c_str());
+
+    my_state.reset_player_disconnect_timer(store);
 }
 
-void ping_master(server_game_state& my_state, int32_t port, udp_sock& to_master)
+///one room. Its own port, state, timers and master registration
+///sessions never touch each other, so a worker can run any number of them off one loop
+struct game_session
 {
-    static sf::Clock clk;
-    static bool init = false;
+    uint32_t port = 0;
 
-    if(clk.getElapsedTime().asSeconds() < 1 && init)
-        return;
+    udp_sock my_server;
+    udp_sock to_master;
 
-    init = true;
+    server_game_state my_state;
 
-    if(!to_master.valid())
+    recv_ring receive_ring;
+    byte_fetch fetch;
+
+    event_loop* loop = nullptr;
+    int reliable_timer = -1;
+
+    bool host(uint32_t pport)
     {
-        if(to_master.udp_connected)
+        port = pport;
+
+        my_server = udp_host(std::to_string(port));
+
+        if(!my_server.valid())
         {
-            to_master.close();
-            printf("Local sock error (this is not caused by master server termination), reopening socket");
+            printf("Could not host on port %u\n", port);
+            return false;
         }
 
-        to_master = udp_connect(MASTER_IP, MASTER_PORT);
+        printf("Registered on port %s\n", my_server.get_host_port().c_str());
 
-        printf("Creating socket to master server\n");
+        my_state.mode_handler.shared_game_state.current_game_mode = game_mode::FFA;
+
+        my_state.set_map(0);
+
+        return true;
     }
 
-    byte_vector vec;
+    ///drains everything that's waiting, the loop calls us again if more turns up
+    void receive()
+    {
+        uint64_t receive_start = profiler::now_us();
 
-    vec.push_back<int32_t>(my_state.player_list.size());
-    vec.push_back<int32_t>(port);
+        int num_received = 0;
 
-    udp_send(to_master, vec.ptr);
+        while((num_received = receive_ring.receive(my_server)) > 0)
+        {
+            for(int slot=0; slot < num_received; slot++)
+            {
+                sockaddr_storage& store = receive_ring.addrs[slot];
 
-    clk.restart();
-}
+                const char* data = receive_ring.data(slot);
 
-using namespace std;
+                int len = receive_ring.lengths[slot];
 
-///so as it turns out, you must use canaries with tcp as its a stream protocol
-///that will by why the map client doesn't work
-///:[
-int main(int argc, char* argv[])
-{
-    //sock_info inf = try_tcp_connect(MASTER_IP, MASTER_PORT);
-    //tcp_sock to_server;
+                uint8_t protocol_version = wire::detect_version(data, len);
 
-    std::string host_port = GAMESERVER_PORT;
+                if(protocol_version == WIRE_VERSION_LEGACY)
+                {
+                    ///reuses fetch's storage, no allocation once it's grown to fit
+                    fetch.ptr.assign(data, data + len);
+                    fetch.internal_counter = 0;
 
-    for(int i=1; i<argc; i++)
-    {
-        if(strncmp(argv[i], "-port", strlen("-port")) == 0)
-        {
-            if(i + 1 < argc)
-            {
-                host_port = argv[i+1];
+                    while(!fetch.finished())
+                    {
+                        int32_t found_canary = fetch.get<int32_t>();
+
+                        while(found_canary != canary_start && !fetch.finished())
+                        {
+                            found_canary = fetch.get<int32_t>();
+                        }
+
+                        if(fetch.finished())
+                            continue;
+
+                        int32_t type = fetch.get<int32_t>();
+
+                        dispatch_message(my_state, my_server, type, fetch, store, protocol_version);
+                    }
+
+                    continue;
+                }
+
+                if(protocol_version != WIRE_VERSION)
+                {
+                    printf("unknown protocol version %i\n", protocol_version);
+                    continue;
+                }
+
+                span_reader reader(data + wire::header_size, len - wire::header_size);
+
+                uint32_t type = 0;
+                uint32_t body_len = 0;
+
+                while(wire::next_message(reader, type, body_len))
+                {
+                    const char* body = reader.data + reader.counter;
+
+                    reader.counter += body_len;
+
+                    ///the handlers check for a trailing canary_end, so they get one
+                    ///fetch only holds this message, so a handler that misreads can't run on into the next
+                    fetch.ptr.assign(body, body + body_len);
+                    fetch.ptr.insert(fetch.ptr.end(), (const char*)&canary_end, (const char*)&canary_end + sizeof(canary_end));
+                    fetch.internal_counter = 0;
+
+                    dispatch_message(my_state, my_server, type, fetch, store, protocol_version);
+                }
             }
         }
+
+        profiler::record("receive", receive_start, profiler::now_us());
     }
 
-    uint32_t pnum = atoi(host_port.c_str());
+    ///everything queued this wakeup goes out in one go
+    void flush()
+    {
+        {
+            PROFILE_SCOPE("packet_clump");
 
-    udp_sock my_server = udp_host(host_port);
+            my_state.packet_clump.tick(my_state.sends);
+        }
 
-    printf("Registered on port %s\n", my_server.get_host_port().c_str());
+        {
+            PROFILE_SCOPE("send_flush");
 
-    server_game_state my_state;
-    my_state.mode_handler.shared_game_state.current_game_mode = game_mode::FFA;
+            my_state.sends.flush();
+        }
 
-    my_state.set_map(0);
+        ///the resend timer only runs while there's something to resend or ack
+        ///otherwise idle rooms would all wake every 4ms for nothing
+        loop->set_timer_armed(reliable_timer, my_state.reliable.has_pending());
+    }
 
-    udp_sock to_master;
+    void add_to(event_loop& loop)
+    {
+        this->loop = &loop;
 
+        loop.add_socket(my_server, [this](){receive();});
 
-    bool once = false;
+        ping_master(my_state, port, to_master);
 
-    bool going = true;
+        loop.add_timer(1000, [this]()
+        {
+            PROFILE_SCOPE("ping_master");
 
-    while(going)
-    {
-        ping_master(my_state, pnum, to_master);
+            ping_master(my_state, port, to_master);
+        });
 
-        /*if(sock_readable(to_server))
+        loop.add_timer(50, [this]()
         {
-            auto dat = tcp_recv(to_server);
-        }
+            PROFILE_SCOPE("balance_teams");
 
-        if(!to_server.valid())
+            my_state.balance_teams();
+        });
+
+        loop.add_timer(1000, [this]()
         {
-            if(!inf.within_timeout())
-            {
-                ///resets sock info
-                inf.retry();
-                inf = try_tcp_connect(MASTER_IP, MASTER_PORT);
+            PROFILE_SCOPE("periodic_team_broadcast");
 
-                printf("trying\n");
-            }
+            my_state.periodic_team_broadcast();
+        });
 
-            if(inf.valid())
-            {
-                to_server = tcp_sock(inf.get());
+        /*my_state.periodic_gamemode_stats_broadcast();
 
-                byte_vector vec;
-                vec.push_back(canary_start);
-                vec.push_back(message::GAMESERVER);
-                vec.push_back<uint32_t>(pnum);
-                vec.push_back(canary_end);
+        my_state.periodic_respawn_info_update();
 
-                tcp_send(to_server, vec.ptr);
+        my_state.periodic_player_stats_update();*/
 
-                printf("found master server\n");
-            }
+        loop.add_timer(100, [this]()
+        {
+            PROFILE_SCOPE("cull_disconnected_players");
 
-            //continue;
-        }*/
+            my_state.cull_disconnected_players();
 
-        bool any_read = true;
+            my_state.prune_object_tracks();
+        });
 
-        while(any_read && sock_readable(my_server))
+        reliable_timer = loop.add_timer(4, [this]()
         {
-            sockaddr_storage store;
+            PROFILE_SCOPE("reliable_tick");
 
-            auto data = udp_receive_from(my_server, &store);
+            my_state.reliable.tick(&my_state);
+        });
 
-            any_read = data.size() > 0;
+        loop.set_timer_armed(reliable_timer, false);
 
-            byte_fetch fetch;
-            fetch.ptr.swap(data);
+        loop.add_timer(my_state.ping_interval_ms, [this]()
+        {
+            PROFILE_SCOPE("ping");
 
-            while(!fetch.finished() && any_read)
-            {
-                int32_t found_canary = fetch.get<int32_t>();
+            my_state.ping();
+        });
 
-                while(found_canary != canary_start && !fetch.finished())
-                {
-                    found_canary = fetch.get<int32_t>();
-                }
+        loop.add_timer(1000, [this]()
+        {
+            PROFILE_SCOPE("broadcast_ping_data");
 
-                if(fetch.finished())
-                    continue;
+            my_state.broadcast_ping_data();
+        });
+    }
+};
 
-                int32_t type = fetch.get<int32_t>();
+///one thread, one loop, however many sessions got dealt to it
+struct session_worker
+{
+    std::vector<game_session*> sessions;
 
-                if(type == message::CLIENTJOINREQUEST)
-                {
-                    my_state.process_join_request(my_server, fetch, store);
-                }
+    event_loop loop;
+    std::thread thread;
 
-                else if(type == message::FORWARDING)
-                {
-                    my_state.process_received_message(fetch, store);
-                }
+    void add(game_session* session)
+    {
+        session->add_to(loop);
 
-                else if(type == message::REPORT)
-                {
-                    my_state.process_reported_message(fetch, store);
-                }
-                else if(type == message::RESPAWNREQUEST)
-                {
-                    my_state.process_respawn_request(my_server, fetch, store);
-                }
-                else if(type == message::FORWARDING_RELIABLE)
-                {
-                    int32_t player_id = my_state.sockaddr_to_playerid(store);
+        sessions.push_back(session);
+    }
 
-                    uint32_t reliable_id = -1;
+    void start(int id)
+    {
+        loop.after_dispatch = [this]()
+        {
+            for(game_session* session : sessions)
+                session->flush();
+        };
 
-                    byte_vector vec = reliability_manager::strip_data_from_forwarding_reliable(fetch, reliable_id);
+        thread = std::thread([this, id]()
+        {
+            profiler::set_thread_name("server_" + std::to_string(id));
 
-                    ///don't want to replicate it back to the player, do we!
-                    ///we're calling add, but add sticks on canaries
-                    ///really we want to strip down the message
+            loop.run();
+        });
+    }
+};
 
-                    ///so uuh. this is instructing the server to just repeatdly forward
-                    ///the message to the client
-                    ///whereas obviously we want to check if they've already got it
-                    ///I'm not smart
-                    my_state.reliable.add(vec, player_id, reliable_id);
-                    my_state.reliable.add_packetid_to_ack(reliable_id, player_id);
-                }
-                else if(type == message::FORWARDING_RELIABLE_ACK)
-                {
-                    my_state.reliable.process_ack(fetch);
-                }
-                else if(type == message::PING_RESPONSE)
-                {
-                    my_state.process_ping_response(my_server, fetch, store);
-                }
-                else if(type == message::PING_GAMESERVER)
-                {
-                    my_state.process_ping_gameserver(my_server, fetch, store);
-                }
-                else
-                {
-                    printf("err %i ", type);
-                }
+using namespace std;
 
-                /*if(!once && my_state.gid == 3)
-                {
-                    printf("pied piping\n");
+///so as it turns out, you must use canaries with tcp as its a stream protocol
+///that will by why the map client doesn't work
+///:[
+int main(int argc, char* argv[])
+{
+    std::string host_port = GAMESERVER_PORT;
 
-                    //my_state.reliable.add(test, -1);
+    ///-trace file.json dumps a chrome trace of the last few seconds, every few seconds
+    std::string trace_file;
 
-                    once = true;
-                }*/
+    ///-sessions n hosts n rooms on ports host_port to host_port + n - 1
+    int num_sessions = 1;
 
-                //printf("client %s:%s\n", get_addr_ip(store).c_str(), get_addr_port(store).c_str());
+    ///-threads n spreads them over n workers, defaults to a worker per core
+    int num_threads = 0;
 
-                my_state.reset_player_disconnect_timer(store);
+    for(int i=1; i<argc; i++)
+    {
+        if(strncmp(argv[i], "-port", strlen("-port")) == 0)
+        {
+            if(i + 1 < argc)
+            {
+                host_port = argv[i+1];
             }
-                ///client pushing data to other clients
         }
 
-        sf::sleep(sf::milliseconds(1));
+        if(strncmp(argv[i], "-trace", strlen("-trace")) == 0)
+        {
+            if(i + 1 < argc)
+            {
+                trace_file = argv[i+1];
+            }
+        }
 
+        if(strncmp(argv[i], "-sessions", strlen("-sessions")) == 0)
+        {
+            if(i + 1 < argc)
+            {
+                num_sessions = atoi(argv[i+1]);
+            }
+        }
 
-        //my_state.tick();
+        if(strncmp(argv[i], "-threads", strlen("-threads")) == 0)
+        {
+            if(i + 1 < argc)
+            {
+                num_threads = atoi(argv[i+1]);
+            }
+        }
+    }
 
-        my_state.balance_teams();
+    num_sessions = std::max(num_sessions, 1);
 
-        my_state.periodic_team_broadcast();
+    if(num_threads <= 0)
+        num_threads = std::max((int)std::thread::hardware_concurrency(), 1);
 
-        /*my_state.periodic_gamemode_stats_broadcast();
+    num_threads = std::min(num_threads, num_sessions);
 
-        my_state.periodic_respawn_info_update();
+    uint32_t pnum = atoi(host_port.c_str());
 
-        my_state.periodic_player_stats_update();*/
+    std::vector<std::unique_ptr<game_session>> sessions;
 
-        my_state.cull_disconnected_players();
+    for(int i=0; i < num_sessions; i++)
+    {
+        std::unique_ptr<game_session> session(new game_session);
 
-        my_state.reliable.tick(&my_state);
+        if(!session->host(pnum + i))
+            continue;
 
-        ///should do tick ping
-        if(my_state.ping_interval_clk.getElapsedTime().asMicroseconds() / 1000.f >= my_state.ping_interval_ms)
-        {
-            my_state.ping();
+        sessions.push_back(std::move(session));
+    }
 
-            my_state.ping_interval_clk.restart();
-        }
+    if(sessions.size() == 0)
+        return 1;
+
+    num_threads = std::min(num_threads, (int)sessions.size());
+
+    std::vector<std::unique_ptr<session_worker>> workers;
 
-        my_state.broadcast_ping_data();
+    for(int i=0; i < num_threads; i++)
+        workers.emplace_back(new session_worker);
 
-        my_state.packet_clump.tick();
+    ///round robin, rooms are all the same size so far
+    for(int i=0; i < (int)sessions.size(); i++)
+        workers[i % num_threads]->add(sessions[i].get());
+
+    ///the trace covers every thread, so only one worker needs to write it
+    if(trace_file != "")
+    {
+        workers[0]->loop.add_timer(10000, [=]()
+        {
+            profiler::dump_chrome_trace(trace_file);
+        });
     }
+
+    printf("Hosting %i sessions on %i threads\n", (int)sessions.size(), num_threads);
+
+    for(int i=0; i < num_threads; i++)
+        workers[i]->start(i);
+
+    for(auto& worker : workers)
+        worker->thread.join();
 }
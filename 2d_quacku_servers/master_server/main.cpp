@@ -5,6 +5,7 @@
 #include <map>
 #include "server.hpp"
 #include "network_messages.hpp"
+#include "../event_loop_shared.hpp"
 
 #include <iostream>
 #include <iomanip>
@@ -64,19 +65,9 @@ udp_serv_info process_ping(byte_fetch& fetch)
 }
 
 ///wouldn't this be great... as some kind of OBJECT PERHAPS?????!!!?!?
-void receive_pings(std::vector<udp_game_server>& servers)
+///one ping per call, the event loop keeps calling while there's more
+void receive_pings(udp_sock& host, std::vector<udp_game_server>& servers)
 {
-    static udp_sock host;
-    static bool init = false;
-
-    if(!init)
-    {
-        host = udp_host(MASTER_PORT);
-        init = true;
-
-        printf("Registerd udp on port %s\n", host.get_host_port().c_str());
-    }
-
     if(!sock_readable(host))
         return;
 
@@ -183,12 +174,26 @@ int main()
 
     std::vector<udp_game_server> udp_serverlist;
 
-    ///I think we have to keepalive the connections
-    while(1)
+    udp_sock ping_host = udp_host(MASTER_PORT);
+
+    printf("Registerd udp on port %s\n", ping_host.get_host_port().c_str());
+
+    event_loop loop;
+
+    loop.add_socket(ping_host, [&]()
+    {
+        receive_pings(ping_host, udp_serverlist);
+    });
+
+    ///game servers ping once a second, so this doesn't need to be any finer than that
+    loop.add_timer(500, [&]()
     {
-        receive_pings(udp_serverlist);
         process_timeouts(udp_serverlist);
+    });
 
+    ///I think we have to keepalive the connections
+    loop.add_socket(client_host_sock, [&]()
+    {
         bool any_read = true;
 
         while(any_read && sock_readable(client_host_sock))
@@ -254,11 +259,11 @@ int main()
                 }
             }
         }
+    });
 
+    loop.run();
 
-        sf::sleep(sf::milliseconds(1));
-    }
-
+    closesocket(ping_host.get());
     closesocket(client_host_sock.get());
 
     ///don't double free!
@@ -47,6 +47,8 @@ namespace message
         PING_GAMESERVER,
         PING_GAMESERVER_RESPONSE,
         PLAYER_STATS_UPDATE_INDIVIDUAL, ///kills, deaths for a player
+        FORWARDING_BATCH, ///many forwarding payloads packed into one datagram, see below
+        VIEW_REPORT, ///client's camera rect, vec2f top left, vec2f bottom right
     };
 }
 
@@ -55,9 +57,42 @@ namespace net_type
     using message_t = int32_t;
     using player_t = int16_t;
     using component_t = int16_t;
+    using object_t = uint32_t;
     using len_t = int8_t;
 }
 
+///need to update this with what system we're using
+///object_id is the owner's entity handle, so it never wraps while the object is alive
+///laid out with no padding, it goes on the wire as is
+struct network_variable
+{
+    net_type::player_t player_id = -1;
+    int16_t system_network_id = -1;
+    net_type::object_t object_id = (net_type::object_t)-1;
+
+    network_variable(int16_t pid, net_type::object_t oid, int16_t sid)
+    {
+        player_id = pid;
+        object_id = oid;
+        system_network_id = sid;
+    }
+
+    network_variable(){}
+};
+
+///canary_start
+///message::FORWARDING_BATCH
+///uint32_t byte length of the entries
+///uint16_t number of entries
+///uint32_t sender's sim tick, for placing the updates in time on the other end
+///entries, each:
+///    network_variable (player_id, system_network_id, object_id)
+///    uint16_t payload length
+///    payload
+///canary_end
+///senders keep a whole batch under forwarding_batch_mtu, the server relays it as is
+#define FORWARDING_BATCH_MTU 1200
+
 ///canary_start
 ///message::REPORT
 ///TYPE
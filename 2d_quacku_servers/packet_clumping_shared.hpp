@@ -3,63 +3,155 @@
 
 #include <net/shared.hpp>
 #include <map>
+#include <unordered_map>
+#include "batch_io_shared.hpp"
+#include "wire_protocol_shared.hpp"
 #include <vector>
 
+///everything going to one address this tick, already framed for them
 struct net_dest
 {
     udp_sock sock;
     sockaddr_storage store;
-    std::vector<char> data;
+    uint8_t protocol_version = WIRE_VERSION;
+
+    ///kept between ticks so appending doesn't allocate, only the first num_datagrams are in use
+    std::vector<std::vector<char>> datagrams;
+    int num_datagrams = 0;
 };
 
-struct net_info
+///a run of bytes owned by someone else, only needs to live until add_message returns
+struct body_slice
 {
-    udp_sock sock;
-    sockaddr_storage store;
+    const char* data = nullptr;
+    uint32_t len = 0;
 };
 
-
 struct packet_clumper
 {
-    std::vector<net_dest> destination_to_senddata;
-    std::vector<net_info> destinations;
+    ///payload per datagram. 1200 keeps us under a 1500 mtu with room for ip/udp headers and tunnels
+    ///a single message bigger than this still goes, on its own
+    uint32_t max_payload = 1200;
+
+    ///same deal as net_dest::datagrams, only the first num_dests are this tick's
+    std::vector<net_dest> dests;
+    int num_dests = 0;
+
+    std::unordered_map<sockaddr_storage, int, sockaddr_hash, sockaddr_equal> dest_lookup;
+
+    ///protocol_version only matters the first time we see a destination in a tick
+    net_dest& get_dest(const udp_sock& sock, const sockaddr_storage& store, uint8_t protocol_version)
+    {
+        auto it = dest_lookup.find(store);
+
+        if(it != dest_lookup.end())
+            return dests[it->second];
+
+        if(num_dests == (int)dests.size())
+            dests.emplace_back();
 
-    void add_send_data(udp_sock& sock, sockaddr_storage& store, const std::vector<char>& dat)
+        net_dest& dest = dests[num_dests];
+        dest.sock = sock;
+        dest.store = store;
+        dest.protocol_version = protocol_version;
+        dest.num_datagrams = 0;
+
+        dest_lookup.emplace(store, num_dests);
+
+        num_dests++;
+
+        return dest;
+    }
+
+    ///one message, framed straight into the destination's current datagram
+    ///starts a new datagram if this one would go over max_payload
+    void add_message(const udp_sock& sock, const sockaddr_storage& store, uint8_t protocol_version, uint32_t type, const char* body, uint32_t len)
     {
-        net_dest dest = {sock, store, dat};
+        body_slice slice;
+        slice.data = body;
+        slice.len = len;
+
+        add_message(sock, store, protocol_version, type, &slice, 1);
+    }
+
+    ///same again, with the body gathered from slices of something else, eg a received datagram
+    void add_message(const udp_sock& sock, const sockaddr_storage& store, uint8_t protocol_version, uint32_t type, const body_slice* slices, int num_slices)
+    {
+        net_dest& dest = get_dest(sock, store, protocol_version);
+
+        uint32_t len = 0;
 
-        destination_to_senddata.push_back(dest);
+        for(int i=0; i < num_slices; i++)
+            len += slices[i].len;
 
-        net_info info = {sock, store};
+        uint32_t size = wire::framed_size(dest.protocol_version, type, len);
+        uint32_t header = wire::datagram_header_size(dest.protocol_version);
 
-        for(auto& i : destinations)
+        bool need_new = dest.num_datagrams == 0;
+
+        if(!need_new)
+        {
+            std::vector<char>& current = dest.datagrams[dest.num_datagrams - 1];
+
+            need_new = current.size() > header && current.size() + size > max_payload;
+        }
+
+        if(need_new)
         {
-            if(i.store == info.store)
-                return;
+            if(dest.num_datagrams == (int)dest.datagrams.size())
+                dest.datagrams.emplace_back();
+
+            std::vector<char>& next = dest.datagrams[dest.num_datagrams];
+            next.clear();
+
+            wire::start_framed(next, dest.protocol_version);
+
+            dest.num_datagrams++;
         }
 
-        destinations.push_back(info);
+        std::vector<char>& out = dest.datagrams[dest.num_datagrams - 1];
+
+        wire::begin_framed(out, dest.protocol_version, type, len);
+
+        for(int i=0; i < num_slices; i++)
+            out.insert(out.end(), slices[i].data, slices[i].data + slices[i].len);
+
+        wire::end_framed(out, dest.protocol_version);
+    }
+
+    ///dat is version 2 messages with no datagram header, split up so each one can go in whichever datagram has room
+    void add_send_data(udp_sock& sock, sockaddr_storage& store, uint8_t protocol_version, const std::vector<char>& dat)
+    {
+        span_reader reader(dat.data(), dat.size());
+
+        uint32_t type = 0;
+        uint32_t len = 0;
+
+        while(wire::next_message(reader, type, len))
+        {
+            add_message(sock, store, protocol_version, type, reader.data + reader.counter, len);
+
+            reader.counter += len;
+        }
     }
 
-    void tick()
+    ///everything's already framed, so this just hands it over. The caller flushes
+    void tick(datagram_batch& out)
     {
-        for(auto& i : destinations)
+        for(int i=0; i < num_dests; i++)
         {
-            std::vector<char> data;
+            net_dest& dest = dests[i];
 
-            for(auto& nd : destination_to_senddata)
+            for(int j=0; j < dest.num_datagrams; j++)
             {
-                if(i.store == nd.store)
-                {
-                    data.insert(data.end(), nd.data.begin(), nd.data.end());
-                }
+                out.add(dest.sock, dest.store, dest.datagrams[j]);
             }
 
-            udp_send_to(i.sock, data, (sockaddr*)&i.store);
+            dest.num_datagrams = 0;
         }
 
-        destination_to_senddata.clear();
-        destinations.clear();
+        num_dests = 0;
+        dest_lookup.clear();
     }
 };
 
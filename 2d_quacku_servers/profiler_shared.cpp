@@ -0,0 +1,277 @@
+#include "profiler_shared.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <stdio.h>
+
+namespace
+{
+    ///a sample as it sits in the ring, atomic so readers can look while the owner keeps writing
+    struct ring_slot
+    {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> start_us{0};
+        std::atomic<uint64_t> end_us{0};
+    };
+
+    ///one per thread that's ever recorded anything, never freed so readers can hold on to them
+    ///only the owning thread writes the ring, so recording is a plain write and a couple of atomic stores
+    ///started is bumped before a slot is overwritten and written after, so a reader can tell if a slot changed under it
+    struct thread_buffer
+    {
+        int tid = 0;
+
+        ///only the name is locked, and it's set once or twice per thread
+        std::mutex name_lock;
+        std::string name;
+
+        std::vector<ring_slot> ring;
+        std::atomic<uint64_t> started{0};
+        std::atomic<uint64_t> written{0};
+
+        thread_buffer() : ring(profiler::ring_size) {}
+
+        std::string get_name()
+        {
+            std::lock_guard<std::mutex> guard(name_lock);
+
+            return name;
+        }
+
+        ///false if the slot for idx was overwritten (or is being) while we read it
+        bool read(uint64_t idx, profiler::sample& out)
+        {
+            const ring_slot& slot = ring[idx % profiler::ring_size];
+
+            out.name = slot.name.load(std::memory_order_relaxed);
+            out.start_us = slot.start_us.load(std::memory_order_relaxed);
+            out.end_us = slot.end_us.load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            return started.load(std::memory_order_relaxed) <= idx + profiler::ring_size;
+        }
+    };
+
+    std::mutex buffers_lock;
+    std::vector<std::unique_ptr<thread_buffer>> buffers;
+
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    thread_buffer& get_thread_buffer()
+    {
+        thread_local thread_buffer* buf = nullptr;
+
+        if(buf != nullptr)
+            return *buf;
+
+        std::lock_guard<std::mutex> guard(buffers_lock);
+
+        buffers.emplace_back(new thread_buffer);
+
+        buf = buffers.back().get();
+        buf->tid = buffers.size();
+        buf->name = "thread " + std::to_string(buf->tid);
+
+        return *buf;
+    }
+
+    std::vector<thread_buffer*> get_buffers()
+    {
+        std::vector<thread_buffer*> ret;
+
+        std::lock_guard<std::mutex> guard(buffers_lock);
+
+        for(auto& i : buffers)
+            ret.push_back(i.get());
+
+        return ret;
+    }
+
+    ///names are code literals, but be safe about what goes in the json
+    std::string escape(const std::string& str)
+    {
+        std::string ret;
+
+        for(char c : str)
+        {
+            if(c == '"' || c == '\\')
+                ret.push_back('\\');
+
+            ret.push_back(c);
+        }
+
+        return ret;
+    }
+}
+
+uint64_t profiler::now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void profiler::set_thread_name(const std::string& name)
+{
+    thread_buffer& buf = get_thread_buffer();
+
+    std::lock_guard<std::mutex> guard(buf.name_lock);
+
+    buf.name = name;
+}
+
+void profiler::record(const char* name, uint64_t start_us, uint64_t end_us)
+{
+    thread_buffer& buf = get_thread_buffer();
+
+    uint64_t idx = buf.written.load(std::memory_order_relaxed);
+
+    buf.started.store(idx + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    ring_slot& slot = buf.ring[idx % ring_size];
+
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start_us.store(start_us, std::memory_order_relaxed);
+    slot.end_us.store(end_us, std::memory_order_relaxed);
+
+    buf.written.store(idx + 1, std::memory_order_release);
+}
+
+void profiler::phase_history::push(float ms, int max_samples)
+{
+    if((int)durations.size() < max_samples)
+    {
+        durations.push_back(ms);
+        return;
+    }
+
+    durations[next] = ms;
+
+    next = (next + 1) % max_samples;
+}
+
+int profiler::recent_reader::intern(const char* name)
+{
+    auto it = name_ids.find(name);
+
+    if(it != name_ids.end())
+        return it->second;
+
+    auto found = ids_by_name.find(name);
+
+    int id = 0;
+
+    if(found != ids_by_name.end())
+    {
+        id = found->second;
+    }
+    else
+    {
+        id = ids_by_name.size();
+
+        ids_by_name[name] = id;
+    }
+
+    name_ids[name] = id;
+
+    return id;
+}
+
+void profiler::recent_reader::poll()
+{
+    std::vector<thread_buffer*> to_read = get_buffers();
+
+    if(cursors.size() < to_read.size())
+        cursors.resize(to_read.size(), 0);
+
+    sample s;
+
+    for(int i=0; i < (int)to_read.size(); i++)
+    {
+        thread_buffer& buf = *to_read[i];
+
+        uint64_t written = buf.written.load(std::memory_order_acquire);
+        uint64_t& cursor = cursors[i];
+
+        ///fell more than a ring behind, skip what's gone
+        if(written - cursor > (uint64_t)ring_size)
+            cursor = written - ring_size;
+
+        for(; cursor < written; cursor++)
+        {
+            if(!buf.read(cursor, s) || s.name == nullptr)
+                continue;
+
+            uint64_t key = ((uint64_t)i << 32) | (uint32_t)intern(s.name);
+
+            auto it = phase_lookup.find(key);
+
+            int phase_idx = 0;
+
+            if(it == phase_lookup.end())
+            {
+                phase_history next_phase;
+                next_phase.label = buf.get_name() + "/" + s.name;
+                next_phase.plot_id = "##" + next_phase.label;
+
+                phase_idx = phases.size();
+                phases.push_back(next_phase);
+
+                phase_lookup[key] = phase_idx;
+            }
+            else
+            {
+                phase_idx = it->second;
+            }
+
+            phases[phase_idx].push((s.end_us - s.start_us) / 1000.f, max_per_phase);
+        }
+    }
+}
+
+bool profiler::dump_chrome_trace(const std::string& file)
+{
+    FILE* pFile = fopen(file.c_str(), "w");
+
+    if(pFile == nullptr)
+    {
+        printf("could not open %s for trace dump\n", file.c_str());
+        return false;
+    }
+
+    std::vector<thread_buffer*> to_read = get_buffers();
+
+    fprintf(pFile, "{\"traceEvents\":[\n");
+
+    bool first = true;
+
+    sample s;
+
+    for(thread_buffer* buf : to_read)
+    {
+        fprintf(pFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", buf->tid, escape(buf->get_name()).c_str());
+
+        first = false;
+
+        uint64_t written = buf->written.load(std::memory_order_acquire);
+        uint64_t num = std::min(written, (uint64_t)ring_size);
+
+        for(uint64_t i = written - num; i < written; i++)
+        {
+            if(!buf->read(i, s) || s.name == nullptr)
+                continue;
+
+            fprintf(pFile, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%i,\"ts\":%llu,\"dur\":%llu}",
+                    escape(s.name).c_str(), buf->tid, (unsigned long long)s.start_us, (unsigned long long)(s.end_us - s.start_us));
+        }
+    }
+
+    fprintf(pFile, "\n]}\n");
+
+    fclose(pFile);
+
+    return true;
+}
@@ -0,0 +1,91 @@
+#ifndef PROFILER_SHARED_HPP_INCLUDED
+#define PROFILER_SHARED_HPP_INCLUDED
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+///scoped timers, each thread records into its own ring buffer, without locking
+///names must be string literals (or otherwise live forever), we only store the pointer
+namespace profiler
+{
+    struct sample
+    {
+        const char* name = nullptr;
+        uint64_t start_us = 0;
+        uint64_t end_us = 0;
+    };
+
+    ///per thread, oldest samples get overwritten
+    const int ring_size = 16384;
+
+    ///microseconds since the profiler first got used
+    uint64_t now_us();
+
+    ///shows up as the thread's name in the trace
+    void set_thread_name(const std::string& name);
+
+    void record(const char* name, uint64_t start_us, uint64_t end_us);
+
+    struct scoped_timer
+    {
+        const char* name;
+        uint64_t start_us;
+
+        scoped_timer(const char* pname) : name(pname), start_us(now_us()) {}
+
+        ~scoped_timer()
+        {
+            record(name, start_us, now_us());
+        }
+    };
+
+    ///one phase on one thread, as seen by a recent_reader
+    struct phase_history
+    {
+        ///"thread/phase", and the same with ## in front for imgui ids. Built once, when the phase first turns up
+        std::string label;
+        std::string plot_id;
+
+        ///ring of durations in ms, the oldest is at next once it's filled up
+        std::vector<float> durations;
+        int next = 0;
+
+        void push(float ms, int max_samples);
+    };
+
+    ///keeps a cursor into each thread's ring, so a poll only reads what's been recorded since the last one
+    ///phases are told apart by thread and interned name, nothing gets built per sample
+    struct recent_reader
+    {
+        int max_per_phase = 120;
+
+        std::vector<phase_history> phases;
+
+        ///per thread, index of the next sample we haven't read
+        std::vector<uint64_t> cursors;
+        ///(thread << 32) | name id -> index into phases
+        std::unordered_map<uint64_t, int> phase_lookup;
+
+        ///the same literal can have a different address in each translation unit, so names are interned by content
+        ///that string compare only happens the first time we see a pointer
+        std::unordered_map<const char*, int> name_ids;
+        std::map<std::string, int> ids_by_name;
+
+        int intern(const char* name);
+
+        void poll();
+    };
+
+    ///chrome://tracing or perfetto, everything still in the ring buffers
+    bool dump_chrome_trace(const std::string& file);
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_SCOPE(name) profiler::scoped_timer PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+
+#endif // PROFILER_SHARED_HPP_INCLUDED
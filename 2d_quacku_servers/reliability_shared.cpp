@@ -1,21 +1,25 @@
 #include "reliability_shared.hpp"
 #include <net/shared.hpp>
 #include "master_server/network_messages.hpp"
+#include "wire_protocol_shared.hpp"
 //#include "../openclrenderer/logging.hpp"
 
 ///wraps data in forward reliable, and gives it an id
 void reliability_manager::add(const byte_vector& vec)
 {
+    ///tick may not have run for a while if nothing was pending, don't age this by the gap
+    if(!has_pending())
+        clk.restart();
+
     std::vector<char> data = vec.ptr;
 
     uint32_t id = gid++;
 
     byte_vector ret;
-    ret.push_back(canary_start);
-    ret.push_back(message::FORWARDING_RELIABLE);
+    size_t body = wire::begin(ret, message::FORWARDING_RELIABLE);
     ret.push_back(id);
     ret.push_string(data, data.size());
-    ret.push_back(canary_end);
+    wire::end(ret, body);
 
     forwarding_info inf;
     inf.data = ret;
@@ -37,16 +41,18 @@ void reliability_manager::add(const byte_vector& vec, uint32_t reliable_id)
             return;
     }
 
+    if(!has_pending())
+        clk.restart();
+
     std::vector<char> data = vec.ptr;
 
     uint32_t id = reliable_id;
 
     byte_vector ret;
-    ret.push_back(canary_start);
-    ret.push_back(message::FORWARDING_RELIABLE);
+    size_t body = wire::begin(ret, message::FORWARDING_RELIABLE);
     ret.push_back(id);
     ret.push_string(data, data.size());
-    ret.push_back(canary_end);
+    wire::end(ret, body);
 
     forwarding_info inf;
     inf.data = ret;
@@ -110,7 +116,11 @@ void reliability_manager::tick(udp_sock& sock, sockaddr_storage& store)
         ///if we're meant to be sending the data, send it
         ///otherwise we simply received the data and we're piping acks
         if(!inf.skip_send)
-            udp_send_to(sock, inf.data.ptr, (const sockaddr*)&store);
+        {
+            wire::frame(inf.data.ptr.data(), inf.data.ptr.size(), protocol_version, frame_scratch);
+
+            udp_send_to(sock, frame_scratch, (const sockaddr*)&store);
+        }
 
         inf.time_elapsed += time_elapsed;
 
@@ -149,12 +159,13 @@ void reliability_manager::tick(udp_sock& sock, sockaddr_storage& store)
             //if(inf.id == packet_ids_to_ack[i] && !inf.sent_ack)
             {
                 byte_vector vec;
-                vec.push_back(canary_start);
-                vec.push_back(message::FORWARDING_RELIABLE_ACK);
+                size_t body = wire::begin(vec, message::FORWARDING_RELIABLE_ACK);
                 vec.push_back<uint32_t>(packet_ids_to_ack[i]);
-                vec.push_back(canary_end);
+                wire::end(vec, body);
+
+                wire::frame(vec.ptr.data(), vec.ptr.size(), protocol_version, frame_scratch);
 
-                udp_send_to(sock, vec.data(), (const sockaddr*)&store);
+                udp_send_to(sock, frame_scratch, (const sockaddr*)&store);
 
                 /*inf.sent_ack = true;
 
@@ -37,8 +37,18 @@ struct reliability_manager
     void process_forwarding_reliable_ack(byte_fetch& fetch);
     void register_ack_forwarding_reliable(uint32_t reliable_id);
 
+    ///anything for tick to resend or ack
+    bool has_pending() const
+    {
+        return data_sending.size() > 0 || packet_ids_to_ack.size() > 0;
+    }
+
     uint32_t gid = 0;
     sf::Clock clk;
+
+    ///data_sending holds version 2 messages, framed to this on the way out
+    uint8_t protocol_version = 2; ///WIRE_VERSION, kept out of here so this header stays free of net includes
+    std::vector<char> frame_scratch;
 };
 
 #endif // RELIABILITY_SHARED_HPP_INCLUDED
@@ -0,0 +1,215 @@
+#ifndef REPLICATION_SHARED_HPP_INCLUDED
+#define REPLICATION_SHARED_HPP_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+#include <vec/vec.hpp>
+#include <net/shared.hpp>
+#include "wire_protocol_shared.hpp"
+
+///positions go over the wire quantized to 1/REPLICATION_STEPS_PER_UNIT of a unit
+///a keyframe is a 16 bit chunk + 16 bit offset within the chunk per axis, so the world is effectively unbounded
+///between keyframes we only send the offset from the last keyframe, and nothing at all if we haven't moved
+///there are no acks for forwarded data, so "baseline" means the most recent keyframe, which goes out every
+///REPLICATION_KEYFRAME_INTERVAL sends. A lost keyframe costs at most that long before deltas make sense again
+#define REPLICATION_STEPS_PER_UNIT 16
+#define REPLICATION_KEYFRAME_INTERVAL 60
+
+///every replicated payload starts with this block, so anyone (eg the server) can pull positions out
+///uint8_t flags
+///uint8_t keyframe sequence
+///KEYFRAME: int16_t chunk_x, chunk_y, uint16_t rel_x, rel_y
+///DELTA_8: int8_t dx, dy from the keyframe
+///DELTA_16: int16_t dx, dy from the keyframe
+namespace replication
+{
+    enum flags : uint8_t
+    {
+        KEYFRAME = 1,
+        DELTA_8 = 2,
+        DELTA_16 = 4,
+        ///something besides position changed, relays must not drop this one
+        FORCED = 8,
+    };
+
+    ///in steps, not units
+    struct quantized_pos
+    {
+        int32_t x = 0;
+        int32_t y = 0;
+
+        bool operator==(const quantized_pos& other) const
+        {
+            return x == other.x && y == other.y;
+        }
+    };
+
+    inline
+    quantized_pos quantize(vec2f pos)
+    {
+        quantized_pos q;
+        q.x = (int32_t)roundf(pos.x() * REPLICATION_STEPS_PER_UNIT);
+        q.y = (int32_t)roundf(pos.y() * REPLICATION_STEPS_PER_UNIT);
+
+        return q;
+    }
+
+    inline
+    vec2f dequantize(quantized_pos q)
+    {
+        return {(float)q.x / REPLICATION_STEPS_PER_UNIT, (float)q.y / REPLICATION_STEPS_PER_UNIT};
+    }
+
+    inline
+    bool fits_int8(int32_t v)
+    {
+        return v >= -128 && v <= 127;
+    }
+
+    inline
+    bool fits_int16(int32_t v)
+    {
+        return v >= -32768 && v <= 32767;
+    }
+
+    ///one per replicated object on the sending side
+    struct position_encoder
+    {
+        bool have_keyframe = false;
+        uint8_t keyframe_seq = 0;
+        quantized_pos keyframe;
+
+        bool have_sent = false;
+        quantized_pos last_sent;
+
+        int since_keyframe = 0;
+
+        ///false and writes nothing if there's nothing worth sending
+        ///force is for when something other than position changed and the payload has to go regardless
+        bool encode(vec2f pos, bool force, byte_vector& out)
+        {
+            quantized_pos q = quantize(pos);
+
+            since_keyframe++;
+
+            bool need_keyframe = !have_keyframe || since_keyframe >= REPLICATION_KEYFRAME_INTERVAL;
+
+            int32_t dx = q.x - keyframe.x;
+            int32_t dy = q.y - keyframe.y;
+
+            if(!fits_int16(dx) || !fits_int16(dy))
+                need_keyframe = true;
+
+            if(!need_keyframe && !force && have_sent && q == last_sent)
+                return false;
+
+            uint8_t extra = force ? FORCED : 0;
+
+            if(need_keyframe)
+            {
+                keyframe_seq++;
+                keyframe = q;
+                have_keyframe = true;
+                since_keyframe = 0;
+
+                out.push_back<uint8_t>(KEYFRAME | extra);
+                out.push_back<uint8_t>(keyframe_seq);
+
+                ///arithmetic shift floors, so negative positions land in negative chunks
+                out.push_back<int16_t>(q.x >> 16);
+                out.push_back<int16_t>(q.y >> 16);
+                out.push_back<uint16_t>(q.x & 0xFFFF);
+                out.push_back<uint16_t>(q.y & 0xFFFF);
+            }
+            else if(fits_int8(dx) && fits_int8(dy))
+            {
+                out.push_back<uint8_t>(DELTA_8 | extra);
+                out.push_back<uint8_t>(keyframe_seq);
+                out.push_back<int8_t>(dx);
+                out.push_back<int8_t>(dy);
+            }
+            else
+            {
+                out.push_back<uint8_t>(DELTA_16 | extra);
+                out.push_back<uint8_t>(keyframe_seq);
+                out.push_back<int16_t>(dx);
+                out.push_back<int16_t>(dy);
+            }
+
+            have_sent = true;
+            last_sent = q;
+
+            return true;
+        }
+    };
+
+    ///one per replicated object on the receiving side
+    struct position_decoder
+    {
+        bool have_keyframe = false;
+        uint8_t keyframe_seq = 0;
+        quantized_pos keyframe;
+
+        ///flags of the last block decoded
+        uint8_t last_flags = 0;
+
+        ///always consumes the whole block
+        ///false if it's a delta against a keyframe we never got, out is left alone
+        template<typename fetch_type>
+        bool decode(fetch_type& fetch, vec2f& out)
+        {
+            uint8_t flags = fetch.template get<uint8_t>();
+            uint8_t seq = fetch.template get<uint8_t>();
+
+            last_flags = flags;
+
+            if(flags & KEYFRAME)
+            {
+                int16_t chunk_x = fetch.template get<int16_t>();
+                int16_t chunk_y = fetch.template get<int16_t>();
+                uint16_t rel_x = fetch.template get<uint16_t>();
+                uint16_t rel_y = fetch.template get<uint16_t>();
+
+                keyframe.x = (int32_t)(((uint32_t)(uint16_t)chunk_x << 16) | rel_x);
+                keyframe.y = (int32_t)(((uint32_t)(uint16_t)chunk_y << 16) | rel_y);
+                keyframe_seq = seq;
+                have_keyframe = true;
+
+                out = dequantize(keyframe);
+
+                return true;
+            }
+
+            int32_t dx = 0;
+            int32_t dy = 0;
+
+            if(flags & DELTA_8)
+            {
+                dx = fetch.template get<int8_t>();
+                dy = fetch.template get<int8_t>();
+            }
+            else if(flags & DELTA_16)
+            {
+                dx = fetch.template get<int16_t>();
+                dy = fetch.template get<int16_t>();
+            }
+            else
+            {
+                return false;
+            }
+
+            if(!have_keyframe || seq != keyframe_seq)
+                return false;
+
+            quantized_pos q;
+            q.x = keyframe.x + dx;
+            q.y = keyframe.y + dy;
+
+            out = dequantize(q);
+
+            return true;
+        }
+    };
+}
+
+#endif // REPLICATION_SHARED_HPP_INCLUDED
@@ -0,0 +1,301 @@
+#ifndef WIRE_PROTOCOL_SHARED_HPP_INCLUDED
+#define WIRE_PROTOCOL_SHARED_HPP_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <vector>
+#include <net/shared.hpp>
+
+///version 2 datagram:
+///uint16_t WIRE_MAGIC
+///uint8_t version
+///then any number of messages, each:
+///varint type
+///varint body length
+///body, same layout as the body of the legacy message of that type
+///
+///legacy (version 1) datagrams are canary_start, int32_t type, body, canary_end, repeated, with no lengths
+///legacy datagrams start with canary_start, which can never be mistaken for the magic
+///
+///messages are built in version 2 form (without the datagram header) and framed per destination on send,
+///so the server can keep talking to old clients that haven't updated yet
+#define WIRE_MAGIC 0x5157
+#define WIRE_VERSION_LEGACY 1
+#define WIRE_VERSION 2
+
+///bounds checked reads over someone else's bytes, for pulling messages and position blocks out in place
+struct span_reader
+{
+    const char* data = nullptr;
+    uint32_t length = 0;
+    uint32_t counter = 0;
+
+    span_reader(const char* pdata, uint32_t plength) : data(pdata), length(plength) {}
+
+    template<typename T>
+    T get()
+    {
+        T ret = T();
+
+        if(counter + sizeof(T) > length)
+        {
+            counter = length;
+            return ret;
+        }
+
+        memcpy(&ret, data + counter, sizeof(T));
+
+        counter += sizeof(T);
+
+        return ret;
+    }
+
+    bool finished() const
+    {
+        return counter >= length;
+    }
+
+    uint32_t remaining() const
+    {
+        return length - counter;
+    }
+};
+
+namespace wire
+{
+    constexpr int header_size = sizeof(uint16_t) + sizeof(uint8_t);
+
+    ///type + length, worst case, for budgeting against an mtu
+    constexpr int max_message_overhead = 5 + 5;
+
+    inline
+    void put_varint(std::vector<char>& out, uint32_t val)
+    {
+        while(val >= 0x80)
+        {
+            out.push_back((char)((val & 0x7F) | 0x80));
+            val >>= 7;
+        }
+
+        out.push_back((char)val);
+    }
+
+    inline
+    int varint_size(uint32_t val)
+    {
+        int num = 1;
+
+        while(val >= 0x80)
+        {
+            val >>= 7;
+            num++;
+        }
+
+        return num;
+    }
+
+    ///false if the reader ran out or the varint is malformed
+    template<typename reader_type>
+    bool get_varint(reader_type& reader, uint32_t& out)
+    {
+        out = 0;
+
+        for(int i=0; i<5; i++)
+        {
+            if(reader.finished())
+                return false;
+
+            uint8_t next = reader.template get<uint8_t>();
+
+            out |= (uint32_t)(next & 0x7F) << (7 * i);
+
+            if((next & 0x80) == 0)
+                return true;
+        }
+
+        return false;
+    }
+
+    inline
+    void start_datagram(byte_vector& vec)
+    {
+        vec.push_back<uint16_t>(WIRE_MAGIC);
+        vec.push_back<uint8_t>(WIRE_VERSION);
+    }
+
+    ///returns where the body starts, hand it to end
+    inline
+    size_t begin(byte_vector& vec, int32_t type)
+    {
+        put_varint(vec.ptr, (uint32_t)type);
+
+        return vec.ptr.size();
+    }
+
+    ///the length goes in front of the body now that we know it
+    inline
+    void end(byte_vector& vec, size_t body_start)
+    {
+        uint32_t len = vec.ptr.size() - body_start;
+
+        char buf[5];
+        int num = 0;
+
+        while(len >= 0x80)
+        {
+            buf[num++] = (char)((len & 0x7F) | 0x80);
+            len >>= 7;
+        }
+
+        buf[num++] = (char)len;
+
+        vec.ptr.insert(vec.ptr.begin() + body_start, buf, buf + num);
+    }
+
+    ///a whole message in one go, when the body already exists somewhere
+    inline
+    void append(byte_vector& vec, int32_t type, const char* body, uint32_t len)
+    {
+        put_varint(vec.ptr, (uint32_t)type);
+        put_varint(vec.ptr, len);
+
+        vec.ptr.insert(vec.ptr.end(), body, body + len);
+    }
+
+    ///WIRE_VERSION, or WIRE_VERSION_LEGACY if it doesn't have our header
+    inline
+    uint8_t detect_version(const char* data, uint32_t len)
+    {
+        if(len < (uint32_t)header_size)
+            return WIRE_VERSION_LEGACY;
+
+        uint16_t magic = 0;
+        memcpy(&magic, data, sizeof(magic));
+
+        if(magic != WIRE_MAGIC)
+            return WIRE_VERSION_LEGACY;
+
+        return (uint8_t)data[sizeof(magic)];
+    }
+
+    ///reads the next message header out of a version 2 datagram
+    ///false at the end, or if the message claims to run past the end of the datagram
+    ///on true, the next len bytes of the reader are the body
+    template<typename reader_type>
+    bool next_message(reader_type& reader, uint32_t& type, uint32_t& len)
+    {
+        if(reader.finished())
+            return false;
+
+        if(!get_varint(reader, type) || !get_varint(reader, len))
+        {
+            printf("malformed message header\n");
+            return false;
+        }
+
+        if(len > reader.remaining())
+        {
+            printf("message of type %u overruns datagram by %u\n", type, len - reader.remaining());
+            return false;
+        }
+
+        return true;
+    }
+
+    ///what goes in front of the first message of a datagram, nothing for legacy
+    inline
+    int datagram_header_size(uint8_t version)
+    {
+        return version == WIRE_VERSION_LEGACY ? 0 : header_size;
+    }
+
+    inline
+    void start_framed(std::vector<char>& out, uint8_t version)
+    {
+        if(version == WIRE_VERSION_LEGACY)
+            return;
+
+        uint16_t magic = WIRE_MAGIC;
+        uint8_t ver = WIRE_VERSION;
+
+        out.insert(out.end(), (const char*)&magic, (const char*)&magic + sizeof(magic));
+        out.push_back((char)ver);
+    }
+
+    ///bytes one message takes up once framed for version
+    inline
+    uint32_t framed_size(uint8_t version, uint32_t type, uint32_t len)
+    {
+        if(version == WIRE_VERSION_LEGACY)
+            return sizeof(canary_start) + sizeof(int32_t) + len + sizeof(canary_end);
+
+        return varint_size(type) + varint_size(len) + len;
+    }
+
+    ///everything in front of a framed message's body. The caller appends exactly len bytes of body, then end_framed
+    inline
+    void begin_framed(std::vector<char>& out, uint8_t version, uint32_t type, uint32_t len)
+    {
+        if(version != WIRE_VERSION_LEGACY)
+        {
+            put_varint(out, type);
+            put_varint(out, len);
+
+            return;
+        }
+
+        int32_t legacy_type = type;
+
+        out.insert(out.end(), (const char*)&canary_start, (const char*)&canary_start + sizeof(canary_start));
+        out.insert(out.end(), (const char*)&legacy_type, (const char*)&legacy_type + sizeof(legacy_type));
+    }
+
+    inline
+    void end_framed(std::vector<char>& out, uint8_t version)
+    {
+        if(version != WIRE_VERSION_LEGACY)
+            return;
+
+        out.insert(out.end(), (const char*)&canary_end, (const char*)&canary_end + sizeof(canary_end));
+    }
+
+    ///one message framed for version, onto a datagram that's already been started
+    inline
+    void append_framed(std::vector<char>& out, uint8_t version, uint32_t type, const char* body, uint32_t len)
+    {
+        begin_framed(out, version, type, len);
+        out.insert(out.end(), body, body + len);
+        end_framed(out, version);
+    }
+
+    ///turns a run of version 2 messages into a datagram the other end can read
+    inline
+    void frame(const char* msgs, uint32_t len, uint8_t version, std::vector<char>& out)
+    {
+        out.clear();
+
+        start_framed(out, version);
+
+        if(version != WIRE_VERSION_LEGACY)
+        {
+            out.insert(out.end(), msgs, msgs + len);
+
+            return;
+        }
+
+        span_reader r(msgs, len);
+
+        uint32_t type = 0;
+        uint32_t body_len = 0;
+
+        while(next_message(r, type, body_len))
+        {
+            append_framed(out, version, type, msgs + r.counter, body_len);
+
+            r.counter += body_len;
+        }
+    }
+}
+
+#endif // WIRE_PROTOCOL_SHARED_HPP_INCLUDED
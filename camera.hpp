@@ -44,6 +44,16 @@ struct camera
         win.setView(view);
     }
 
+    ///world space rect the view covers, valid after update_camera
+    void get_visible_rect(vec2f& tl, vec2f& br)
+    {
+        auto center = view.getCenter();
+        auto size = view.getSize();
+
+        tl = {center.x - size.x/2.f, center.y - size.y/2.f};
+        br = {center.x + size.x/2.f, center.y + size.y/2.f};
+    }
+
     void set_zoom(float pzoom)
     {
         zoom = pzoom;
@@ -3,88 +3,77 @@
 
 //#include "state.hpp"
 
-struct physics_object_base;
+struct projectile;
 
-struct does_chemical_reactions
+struct physics_object_base : base_class
 {
-    virtual void interact(float dt_s, chemical_interaction_base<physics_object_base>& items, state& st)
+    physics_object_base(int team)
     {
+        texture_key tex;
+        tex.shape = texture_shape::SQUARE;
+        tex.width = 20;
+        tex.height = 20;
 
-    }
-};
+        entities.transforms.add(entity);
 
-struct projectile;
+        render_component& r = entities.renders.add(entity);
+        r.shape = render_shape::SPRITE;
+        r.tex = tex;
+        r.col = generate_colour();
 
-///do damage properly with pending damage in damageable
-struct physics_object_base : virtual moveable, virtual renderable, virtual collideable, virtual base_class, virtual network_serialisable, virtual does_chemical_reactions
-{
-    physics_object_base(int team) : collideable(team, collide::RAD)
-    {
-        collision_dim = {tex.getSize().x, tex.getSize().y};
+        collision_component& c = entities.collisions.add(entity);
+        c.team = team;
+        c.type = collide::RAD;
+        c.group = collide::PARTICLE;
+        c.collision_dim = {tex.width, tex.height};
+
+        entities.networks.add(entity);
     }
 
     virtual void tick(float dt_s, state& st) {};
 
     virtual void resolve_barrier_collisions(float dt_s, state& st) {};
 
-    virtual void set_owner(int id)
-    {
-        network_serialisable::set_owner(id);
+    virtual void interact(float dt_s, object_manager<physics_object_base>& items, state& st) {};
 
-        team = id;
-    }
-
-    /*virtual void render(sf::RenderWindow& win, vec2f pos)
+    virtual void set_owner(int id) override
     {
-        if(!should_render)
-            return;
-
-        if(out_of_bounds(win, pos, 10.f))
-            return;
+        base_class::set_owner(id);
 
-        sf::Sprite spr(tex);
-        spr.setOrigin(tex.getSize().x/2, tex.getSize().y/2);
-        spr.setPosition({pos.x(), pos.y()});
-        spr.setColor(sf::Color(255 * col.x(), 255 * col.y(),255 * col.z()));
-
-        win.draw(spr);
-    }*/
+        collider().team = id;
+    }
 };
 
 ///slave network character
-struct physics_object_client : virtual physics_object_base, virtual networkable_client
+struct physics_object_client : physics_object_base
 {
-    bool have_pos = false;
+    replication::position_encoder pos_encoder;
+    replication::position_decoder pos_decoder;
 
-    physics_object_client() : collideable(-1, collide::RAD), physics_object_base(-1) {}
+    physics_object_client() : physics_object_base(-1)
+    {
+        network().mode = net_mode::CLIENT;
 
+        entities.interpolations.add(entity);
+    }
+
+    ///only sent when should_update is set, so always goes
     virtual byte_vector serialise_network() override
     {
         byte_vector vec;
-        vec.push_back(pos);
+        pos_encoder.encode(transform().pos, true, vec);
 
         return vec;
     }
 
-    virtual void deserialise_network(byte_fetch& fetch) override
+    virtual void deserialise_network(packet_view& fetch) override
     {
-        vec2f fpos = fetch.get<vec2f>();
-
-        pos = fpos;
-
-        if(!have_pos)
-        {
-            collideable::init_collision_pos(pos);
-
-            have_pos = true;
-        }
+        vec2f fpos;
 
-        set_collision_pos(pos);
-    }
+        if(!pos_decoder.decode(fetch, fpos))
+            return;
 
-    void render(sf::RenderWindow& win) override
-    {
-        renderable::render(win, pos, rotation);
+        receive_position(fetch, fpos);
     }
 };
 
@@ -104,10 +93,18 @@ struct particle_parameters
 };
 
 ///solids next
-struct physics_object_host : virtual physics_object_base, virtual networkable_host
+struct physics_object_host : physics_object_base
 {
     bool fixed = false;
 
+    replication::position_encoder pos_encoder;
+    replication::position_decoder pos_decoder;
+
+    bool has_default = false;
+    bool on_default_side = false;
+    float side_time = 0.f;
+    float side_time_max = 0.100f;
+
     vec2f last_pos;
     vec2f leftover_pos_adjustment;
 
@@ -152,14 +149,22 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
         vec2f bond_dir = {cos(bond_angle), sin(bond_angle)};
 
         ///we're getting the absolute bond angle
-        bond_dir = bond_dir.rot(rotation);
+        bond_dir = bond_dir.rot(transform().rotation);
 
         return bond_dir;
     }
 
-    physics_object_host(int team, network_state& ns) : physics_object_base(team), collideable(team, collide::RAD), networkable_host(ns)
+    physics_object_host(int team, network_state& ns) : physics_object_base(team)
     {
-        rotation = randf_s(0.f, M_PI);
+        network().mode = net_mode::HOST;
+
+        set_owner(ns.my_id);
+
+        render_info().shape = render_shape::PARTICLE;
+
+        transform().rotation = randf_s(0.f, M_PI);
+
+        sync_render_component();
     }
 
     vec3f get_colour()
@@ -189,48 +194,25 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
         return colour;
     }
 
-    ///PROJECT ORGANISATION FUCKUP, SHOULD BE UNDER BASE
-    void render(sf::RenderWindow& win) override
+    ///phase, params and fixed are poked directly by the editor after spawning
+    ///so whoever changes them calls this
+    void sync_render_component()
     {
-        //renderable::render(win, pos, rotation);
-
-        if(out_of_bounds(win, pos, 10.f * params.particle_size))
-            return;
-
-        vec3f fcol = get_colour() * 255.f;
-
-        sf::CircleShape circle;
-        circle.setRadius(10.f * params.particle_size);
-        circle.setOrigin(10 * params.particle_size, 10 * params.particle_size);
+        render_component& r = render_info();
 
-        //if(!fixed)
-        circle.setFillColor(sf::Color(fcol.x(), fcol.y(), fcol.z()));
-        //else
-        //    circle.setFillColor(sf::Color(255, 255, 255));
-
-        circle.setOutlineThickness(2);
-        circle.setOutlineColor(sf::Color(fcol.x()/2.f, fcol.y()/2.f, fcol.z()/2.f));
-        circle.setPosition(pos.x(), pos.y());
-
-        win.draw(circle);
-
-        for(int i = 0; i < params.num_bonds; i++)
-        {
-            vec2f abs_dir = get_bond_dir_absolute(i);
+        r.col = get_colour();
+        r.rad = 10.f * params.particle_size;
+        r.num_bonds = params.num_bonds;
+        r.bond_length = bond_length;
 
-            sf::RectangleShape shape;
-            shape.setSize({bond_length, 2});
-            shape.setOrigin(0, 1);
-
-            shape.setPosition(pos.x(), pos.y());
-            shape.setRotation(r2d(abs_dir.angle()));
-
-            win.draw(shape);
-        }
+        ///size may have changed, keep culling up to date
+        entities.moved(entity);
     }
 
     vec2f reflect_physics(vec2f next_pos, physics_barrier* bar)
     {
+        vec2f& pos = transform().pos;
+
         vec2f cdir = (next_pos - pos).norm();
         float clen = (next_pos - pos).length();
 
@@ -279,8 +261,10 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
     ///it seems likely that we have a bad accum, which then causes the character to be pushed through a vector
     ///test if placing a point next to the new vector rwith the relative position of the old, then applying the accum * extreme
     ///would push the character through the vector. If true, rverse it
-    vec2f stick_physics(vec2f next_pos, physics_barrier* bar, physics_barrier* closest, vec2f& accumulate_shift) const
+    vec2f stick_physics(vec2f next_pos, physics_barrier* bar, physics_barrier* closest, vec2f& accumulate_shift)
     {
+        vec2f pos = transform().pos;
+
         vec2f cdir = (next_pos - pos).norm();
         float clen = (next_pos - pos).length();
 
@@ -314,6 +298,8 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
 
     physics_barrier* get_closest(vec2f next_pos, physics_barrier_manager& physics_barrier_manage)
     {
+        vec2f pos = transform().pos;
+
         float min_dist = FLT_MAX;
         physics_barrier* min_bar = nullptr;
 
@@ -376,6 +362,8 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
     ///this should mean that given consistently defined normals (ie dont randomly flip adjacent), we should be fine
     vec2f adjust_next_pos_for_physics(vec2f next_pos, physics_barrier_manager& physics_barrier_manage)
     {
+        vec2f& pos = transform().pos;
+
         physics_barrier* min_bar = get_closest(next_pos, physics_barrier_manage);
 
         if(side_time > side_time_max)
@@ -500,10 +488,12 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
 
     void spawn(vec2f spawn_pos, game_world_manager& game_world_manage)
     {
-        pos = spawn_pos;
-        last_pos = pos;
+        transform().pos = spawn_pos;
+        last_pos = spawn_pos;
 
-        should_render = true;
+        entities.moved(entity);
+
+        render_info().should_render = true;
     }
 
     particle_parameters params;
@@ -514,11 +504,13 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
 
     ///Ok. Above works fine. Solids are ok, gas is great, liquids need to diffuse which means probably adding random jitter depending
     ///on their energy
-    virtual void interact(float dt_s, chemical_interaction_base<physics_object_base>& items, state& st) override
+    virtual void interact(float dt_s, object_manager<physics_object_base>& items, state& st) override
     {
         if(fixed)
             return;
 
+        vec2f pos = transform().pos;
+
         vec2f next_pos = try_next;
 
         ///relax later
@@ -536,7 +528,7 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
             if((void*)this == (void*)obj)
                 continue;
 
-            vec2f their_pos = obj->pos;
+            vec2f their_pos = obj->transform().pos;
 
             vec2f to_them = their_pos - pos;
 
@@ -573,7 +565,7 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
                     {
                         vec2f their_bond_dir = real->get_bond_dir_absolute(their_bond_c);
 
-                        vec2f their_bond_pos = their_bond_dir * real->bond_length + real->pos;
+                        vec2f their_bond_pos = their_bond_dir * real->bond_length + their_pos;
 
                         vec2f my_to_them = (their_bond_pos - my_bond_pos);
 
@@ -621,7 +613,7 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
             vec2f nto_them = (to_them / tlen);
 
             float approx_vel = (try_next - pos).length();
-            float their_approx = ((real->pos - real->last_pos)).length();
+            float their_approx = ((their_pos - real->last_pos)).length();
 
             if(tlen < rdist * 4 && !is_gas)
             {
@@ -631,7 +623,7 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
 
                 float tdist = 1.f - (tlen / (rdist * 4));
 
-                next_pos = mix((next_pos - pos), (real->try_next - real->pos), params.fluid_thickness * tdist / relax_count) + pos;
+                next_pos = mix((next_pos - pos), (real->try_next - their_pos), params.fluid_thickness * tdist / relax_count) + pos;
             }
 
             ///if tlen < length, we are knocked by another particle
@@ -683,6 +675,8 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
 
     void tick(float dt, state& st) override
     {
+        vec2f pos = transform().pos;
+
         do_gravity({0, 1});
 
         float dt_f = dt / last_dt;
@@ -732,6 +726,9 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
 
     virtual void resolve_barrier_collisions(float dt, state& st) override
     {
+        transform_component& trans = transform();
+        vec2f& pos = trans.pos;
+
         vec2f next_pos = adjust_next_pos_for_physics(try_next, st.physics_barrier_manage);
 
         last_dt = dt;
@@ -759,7 +756,7 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
 
         side_time += dt;
 
-        rotation += rotation_accumulate;
+        trans.rotation += rotation_accumulate;
         rotation_accumulate = 0.f;
     }
 
@@ -777,34 +774,40 @@ struct physics_object_host : virtual physics_object_base, virtual networkable_ho
     {
         byte_vector ret;
 
-        ret.push_back<vec2f>(pos);
+        ret.push_back<vec2f>(transform().pos);
 
         return ret;
     }
 
     void deserialise(byte_fetch& fetch)
     {
-        pos = fetch.get<vec2f>();
+        transform().pos = fetch.get<vec2f>();
+
+        entities.moved(entity);
     }
 
+    ///empty if we haven't moved since the last send, network_system skips those
     virtual byte_vector serialise_network() override
     {
         byte_vector vec;
 
-        vec.push_back<vec2f>(pos);
-
+        pos_encoder.encode(transform().pos, false, vec);
 
         return vec;
     }
 
-    virtual void deserialise_network(byte_fetch& fetch) override
+    ///clients only send us damage updates, the position is theirs to ignore
+    virtual void deserialise_network(packet_view& fetch) override
     {
-        vec2f fpos = fetch.get<vec2f>();
+        vec2f fpos;
+
+        pos_decoder.decode(fetch, fpos);
     }
 };
 
-struct physics_object_manager : virtual renderable_manager_base<physics_object_base>, virtual collideable_manager_base<physics_object_base>, virtual network_manager_base<physics_object_base>, virtual chemical_interaction_base<physics_object_base>
+struct physics_object_manager : object_manager<physics_object_base>
 {
+    timestep_state fts;
     timestep_state fts1;
     timestep_state fts2;
 
@@ -838,7 +841,20 @@ struct physics_object_manager : virtual renderable_manager_base<physics_object_b
         }
     }
 
-    virtual ~physics_object_manager(){}
+    void check_interaction(float dt_s, state& st, object_manager<physics_object_base>& other)
+    {
+        int nsteps = fts.step(dt_s);
+
+        for(int kk=0; kk < nsteps; kk++)
+        {
+            for(int i=0; i<objs.size(); i++)
+            {
+                physics_object_base* my_t = objs[i];
+
+                my_t->interact(fts.get_max_step(dt_s), other, st);
+            }
+        }
+    }
 };
 
 #endif // CHARACTER_HPP_INCLUDED
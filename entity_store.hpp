@@ -0,0 +1,378 @@
+#ifndef ENTITY_STORE_HPP_INCLUDED
+#define ENTITY_STORE_HPP_INCLUDED
+
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <vec/vec.hpp>
+
+#include "spatial_index.hpp"
+#include "jitter_buffer.hpp"
+
+struct base_class;
+
+///every object owns exactly one entity, components hang off it
+///a handle is a slot index plus a generation, packed into 32 bits so it can go straight on the wire
+///slots are recycled oldest first, the generation stops stale handles matching the new occupant
+///handles are object ids on the wire, so a slot is retired rather than letting its generation wrap
+using entity_t = uint32_t;
+
+#define ENTITY_INDEX_BITS 20
+#define ENTITY_GENERATION_BITS 12
+
+const uint32_t entity_index_mask = (1u << ENTITY_INDEX_BITS) - 1;
+const uint32_t entity_generation_mask = (1u << ENTITY_GENERATION_BITS) - 1;
+
+///never handed out, the top slot is reserved for it
+const entity_t invalid_entity = 0xFFFFFFFF;
+
+inline
+uint32_t entity_index(entity_t e)
+{
+    return e & entity_index_mask;
+}
+
+inline
+uint32_t entity_generation(entity_t e)
+{
+    return (e >> ENTITY_INDEX_BITS) & entity_generation_mask;
+}
+
+inline
+entity_t make_entity(uint32_t index, uint32_t generation)
+{
+    return (index & entity_index_mask) | ((generation & entity_generation_mask) << ENTITY_INDEX_BITS);
+}
+
+namespace collide
+{
+    enum type
+    {
+        NONE,
+        RAD,
+        PHYS_LINE,
+    };
+
+    ///which pass a collider takes part in, replaces iterating a manager's objs
+    enum group
+    {
+        NO_GROUP,
+        PARTICLE,
+        PROJECTILE,
+        BARRIER,
+    };
+}
+
+using collide_t = collide::type;
+using collide_group_t = collide::group;
+
+namespace render_shape
+{
+    enum type
+    {
+        NONE,
+        SPRITE, ///textured square
+        CIRCLE,
+        PARTICLE, ///outlined circle + bonds
+    };
+}
+
+using render_shape_t = render_shape::type;
+
+namespace texture_shape
+{
+    enum type
+    {
+        NONE,
+        SQUARE, ///solid white, tinted by col
+    };
+}
+
+using texture_shape_t = texture_shape::type;
+
+///sprites say what their texture looks like rather than owning one
+///the render side creates one shared texture per key the first time it's drawn
+struct texture_key
+{
+    texture_shape_t shape = texture_shape::NONE;
+    uint16_t width = 0;
+    uint16_t height = 0;
+
+    uint64_t hash() const
+    {
+        return ((uint64_t)shape << 32) | ((uint64_t)width << 16) | height;
+    }
+};
+
+namespace net_mode
+{
+    enum type
+    {
+        NONE,
+        HOST, ///we own it, send our state every tick
+        CLIENT, ///someone else owns it, only send when should_update
+    };
+}
+
+using net_mode_t = net_mode::type;
+
+struct transform_component
+{
+    vec2f pos = {0,0};
+    float rotation = 0.f;
+};
+
+struct velocity_component
+{
+    vec2f vel = {0,0};
+    float gravity = 0.f;
+};
+
+struct render_component
+{
+    render_shape_t shape = render_shape::NONE;
+    vec3f col = {1, 1, 1};
+    float rad = 10.f;
+    bool should_render = true;
+
+    ///particles only
+    int num_bonds = 0;
+    float bond_length = 0.f;
+
+    ///sprites only
+    texture_key tex;
+
+    ///furthest anything we draw gets from the transform, for culling
+    float extent() const
+    {
+        float ext = rad + 2.f;
+
+        if(num_bonds > 0)
+            ext = std::max(ext, bond_length + 1.f);
+
+        if(shape == render_shape::SPRITE)
+            ext = std::max(ext, std::max(tex.width, tex.height) * 0.7072f);
+
+        return ext;
+    }
+};
+
+struct collision_component
+{
+    int team = 0;
+    collide_t type = collide::NONE;
+    collide_group_t group = collide::NO_GROUP;
+    bool enabled = true;
+
+    vec2f last_collision_pos = {0,0};
+    vec2f collision_pos = {0,0};
+    vec2f collision_dim = {2, 2};
+};
+
+struct network_component
+{
+    net_mode_t mode = net_mode::NONE;
+    int owning_id = -1;
+    int16_t system_network_id = -1;
+
+    ///client objects only send when something changed locally
+    bool should_update = false;
+
+    ///how much this type matters per tick, relative to a settled particle at 1
+    float replication_priority = 1.f;
+    ///grows every tick we're not sent, reset when we are
+    float priority_accum = 0.f;
+};
+
+///dense storage for a single component type
+///sparse maps entity slot -> index into dense, owners maps index -> full entity handle
+///removal moves the last element into the hole so dense never has gaps
+///references returned by get/add are invalidated by the next add/remove on the same array
+template<typename T>
+struct component_array
+{
+    std::vector<T> dense;
+    std::vector<entity_t> owners;
+    std::vector<int32_t> sparse;
+
+    ///handed back by get/add for invalid_entity, never stored. Lets constructors add and touch components
+    ///without checking whether the store had room for them, make_new throws the object away afterwards
+    T scratch;
+
+    ///owners holds the whole handle, so a stale handle to a recycled slot doesn't match
+    bool has(entity_t e) const
+    {
+        uint32_t slot = entity_index(e);
+
+        return slot < sparse.size() && sparse[slot] != -1 && owners[sparse[slot]] == e;
+    }
+
+    T& get(entity_t e)
+    {
+        if(e == invalid_entity)
+            return scratch;
+
+        return dense[sparse[entity_index(e)]];
+    }
+
+    T& add(entity_t e, const T& t = T())
+    {
+        if(e == invalid_entity)
+        {
+            scratch = t;
+            return scratch;
+        }
+
+        uint32_t slot = entity_index(e);
+
+        if(slot >= sparse.size())
+            sparse.resize(slot + 1, -1);
+
+        if(sparse[slot] != -1)
+        {
+            dense[sparse[slot]] = t;
+            owners[sparse[slot]] = e;
+
+            return dense[sparse[slot]];
+        }
+
+        sparse[slot] = dense.size();
+
+        dense.push_back(t);
+        owners.push_back(e);
+
+        return dense.back();
+    }
+
+    void remove(entity_t e)
+    {
+        if(!has(e))
+            return;
+
+        int32_t idx = sparse[entity_index(e)];
+        int32_t last = (int32_t)dense.size() - 1;
+
+        if(idx != last)
+        {
+            dense[idx] = std::move(dense[last]);
+            owners[idx] = owners[last];
+
+            sparse[entity_index(owners[idx])] = idx;
+        }
+
+        dense.pop_back();
+        owners.pop_back();
+
+        sparse[entity_index(e)] = -1;
+    }
+
+    int size() const
+    {
+        return dense.size();
+    }
+};
+
+struct entity_store
+{
+    ///slot -> owning object, nullptr when the slot is free
+    std::vector<base_class*> objects;
+    std::vector<uint32_t> generations;
+    ///fifo, so a slot sits out as long as possible before its next generation goes out
+    std::deque<uint32_t> free_slots;
+
+    component_array<transform_component> transforms;
+    component_array<velocity_component> velocities;
+    component_array<render_component> renders;
+    component_array<collision_component> collisions;
+    component_array<network_component> networks;
+    ///remote objects only, see interpolation_system
+    component_array<jitter_buffer> interpolations;
+
+    ///where renderables are, for view culling
+    spatial_index<entity_t> visible;
+
+    ///invalid_entity if every slot is in use or retired
+    entity_t create(base_class* owner)
+    {
+        uint32_t slot = 0;
+
+        if(free_slots.size() > 0)
+        {
+            slot = free_slots.front();
+            free_slots.pop_front();
+        }
+        else
+        {
+            slot = objects.size();
+
+            if(slot >= entity_index_mask)
+                return invalid_entity;
+
+            objects.push_back(nullptr);
+            generations.push_back(0);
+        }
+
+        objects[slot] = owner;
+
+        return make_entity(slot, generations[slot]);
+    }
+
+    bool alive(entity_t e) const
+    {
+        uint32_t slot = entity_index(e);
+
+        return slot < objects.size() && objects[slot] != nullptr && generations[slot] == entity_generation(e);
+    }
+
+    void destroy(entity_t e)
+    {
+        if(!alive(e))
+            return;
+
+        transforms.remove(e);
+        velocities.remove(e);
+        renders.remove(e);
+        collisions.remove(e);
+        networks.remove(e);
+        interpolations.remove(e);
+
+        visible.remove(entity_index(e), entity_index);
+
+        uint32_t slot = entity_index(e);
+
+        objects[slot] = nullptr;
+
+        ///wrapping would hand out a handle someone might still be holding
+        if(generations[slot] == entity_generation_mask)
+            return;
+
+        generations[slot]++;
+
+        free_slots.push_back(slot);
+    }
+
+    ///call after writing a transform, keeps the entity findable by the renderer
+    ///base_class::set_collision_pos and init_collision_pos do this for you
+    void moved(entity_t e)
+    {
+        if(!transforms.has(e) || !renders.has(e))
+            return;
+
+        visible.update(entity_index(e), e, transforms.get(e).pos, renders.get(e).extent(), entity_index);
+    }
+
+    ///O(1), nullptr if the handle is stale
+    base_class* get_object(entity_t e)
+    {
+        if(!alive(e))
+            return nullptr;
+
+        return objects[entity_index(e)];
+    }
+};
+
+///shared state
+///every object has a unique id globally
+extern entity_store entities;
+
+#endif // ENTITY_STORE_HPP_INCLUDED
@@ -0,0 +1,125 @@
+#ifndef JITTER_BUFFER_HPP_INCLUDED
+#define JITTER_BUFFER_HPP_INCLUDED
+
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <vec/vec.hpp>
+
+///everyone's sim steps at this rate, so a sender's tick number is also a timestamp
+#define SENDER_TICK_S (1/60.f)
+
+///received positions for a remote object, ordered by the tick the sender stamped them with
+///rather than snapping to each one as it arrives, we play them back a little behind real time
+///the delay adapts to how far apart updates are and how much their arrival wobbles
+struct jitter_buffer
+{
+    struct sample
+    {
+        uint32_t tick = 0;
+        vec2f pos = {0,0};
+    };
+
+    static constexpr int max_samples = 16;
+
+    std::vector<sample> samples;
+
+    ///received time - sent time, tracks the low envelope, so the fastest packets define "on time"
+    bool have_offset = false;
+    float offset_s = 0.f;
+
+    ///how late packets are on average compared to the fastest
+    float jitter_s = 0.f;
+
+    ///gap between updates the sender is actually managing
+    float interval_s = 1/20.f;
+
+    void push(uint32_t tick, vec2f pos, float received_s)
+    {
+        float offset = received_s - tick * SENDER_TICK_S;
+
+        if(!have_offset || offset < offset_s)
+        {
+            offset_s = offset;
+            have_offset = true;
+        }
+        else
+        {
+            ///let it creep back up, in case the clocks drift apart
+            offset_s += (offset - offset_s) * 0.01f;
+        }
+
+        jitter_s += ((offset - offset_s) - jitter_s) * 0.1f;
+
+        if(samples.size() > 0 && tick > samples.back().tick)
+        {
+            ///objects that stop moving stop sending, don't let the gap after count
+            float gap = std::min((tick - samples.back().tick) * SENDER_TICK_S, 0.25f);
+
+            interval_s += (gap - interval_s) * 0.1f;
+        }
+
+        ///out of order, find where it goes. duplicates are dropped
+        auto it = std::lower_bound(samples.begin(), samples.end(), tick, [](const sample& s, uint32_t t){return s.tick < t;});
+
+        if(it != samples.end() && it->tick == tick)
+            return;
+
+        sample s;
+        s.tick = tick;
+        s.pos = pos;
+
+        samples.insert(it, s);
+
+        if((int)samples.size() > max_samples)
+            samples.erase(samples.begin());
+    }
+
+    float delay_s() const
+    {
+        return interval_s + jitter_s * 2.f;
+    }
+
+    ///false if there's nothing to show yet
+    bool sample_at(float now_s, vec2f& out)
+    {
+        if(samples.size() == 0)
+            return false;
+
+        float render_tick = (now_s - offset_s - delay_s()) / SENDER_TICK_S;
+
+        ///fell behind the buffer, hold the newest rather than extrapolate
+        if(render_tick >= samples.back().tick)
+        {
+            out = samples.back().pos;
+            return true;
+        }
+
+        if(render_tick <= samples.front().tick)
+        {
+            out = samples.front().pos;
+            return true;
+        }
+
+        int next = 1;
+
+        while(next < (int)samples.size() && samples[next].tick < render_tick)
+            next++;
+
+        const sample& s1 = samples[next - 1];
+        const sample& s2 = samples[next];
+
+        float frac = (render_tick - s1.tick) / (float)(s2.tick - s1.tick);
+
+        out = s1.pos + (s2.pos - s1.pos) * frac;
+
+        ///we'll never need anything before s1 again
+        if(next - 1 > 0)
+            samples.erase(samples.begin(), samples.begin() + (next - 1));
+
+        return true;
+    }
+};
+
+#endif // JITTER_BUFFER_HPP_INCLUDED
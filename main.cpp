@@ -8,7 +8,12 @@
 #include "util.hpp"
 #include <net/shared.hpp>
 #include <set>
+#include <thread>
+#include <mutex>
+#include <atomic>
 #include "camera.hpp"
+#include "spsc_queue.hpp"
+#include "profiler_panel.hpp"
 #include "state.hpp"
 #include "systems.hpp"
 
@@ -40,7 +45,8 @@ bool suppress_mouse = false;
     }
 };*/
 
-struct physics_barrier : virtual renderable, virtual collideable, virtual base_class
+///barriers are static geometry, drawn by static_geometry_renderer rather than the render system
+struct physics_barrier : base_class
 {
     vec2f p1;
     vec2f p2;
@@ -50,14 +56,20 @@ struct physics_barrier : virtual renderable, virtual collideable, virtual base_c
     ///connected to p2
     physics_barrier* prev = nullptr;
 
-    physics_barrier() : collideable(-1, collide::PHYS_LINE) {}
+    physics_barrier()
+    {
+        collision_component& c = entities.collisions.add(entity);
+        c.team = -1;
+        c.type = collide::PHYS_LINE;
+        c.group = collide::BARRIER;
+    }
 
-    bool intersects(collideable* other)
+    bool intersects(const collision_component& other) override
     {
-        if(other->type != collide::RAD)
+        if(other.type != collide::RAD)
             return false;
 
-        if(crosses(other->collision_pos, other->last_collision_pos))
+        if(crosses(other.collision_pos, other.last_collision_pos))
         {
             return true;
         }
@@ -65,24 +77,6 @@ struct physics_barrier : virtual renderable, virtual collideable, virtual base_c
         return false;
     }
 
-    virtual void render(sf::RenderWindow& win)
-    {
-        sf::RectangleShape rect;
-
-        float width = (p2 - p1).length();
-        float height = 5.f;
-
-        rect.setSize({width, height});
-
-        float angle = (p2 - p1).angle();
-
-        rect.setRotation(r2d(angle));
-
-        rect.setPosition(p1.x(), p1.y());
-
-        win.draw(rect);
-    }
-
     int side(vec2f pos)
     {
         vec2f line = (p2 - p1).norm();
@@ -264,12 +258,20 @@ struct physics_barrier : virtual renderable, virtual collideable, virtual base_c
     }
 };
 
-struct physics_barrier_manager : virtual renderable_manager_base<physics_barrier>, virtual collideable_manager_base<physics_barrier>
+struct barrier_segment
+{
+    vec2f p1;
+    vec2f p2;
+};
+
+struct physics_barrier_manager : object_manager<physics_barrier>
 {
     bool adding = false;
     vec2f adding_point;
 
-    bool show_normals = false;
+    ///barriers only change through add_point and deserialise (which load goes through)
+    ///set when they do, so the sim knows to hand the new geometry to the render thread
+    bool geometry_dirty = true;
 
     void add_point(vec2f pos, state& st)
     {
@@ -287,10 +289,16 @@ struct physics_barrier_manager : virtual renderable_manager_base<physics_barrier
             vec2f p2 = pos;
 
             physics_barrier* bar = make_new<physics_barrier>();
+
+            adding = false;
+
+            if(bar == nullptr)
+                return;
+
             bar->p1 = adding_point;
             bar->p2 = p2;
 
-            adding = false;
+            geometry_dirty = true;
 
             return;
         }
@@ -312,18 +320,26 @@ struct physics_barrier_manager : virtual renderable_manager_base<physics_barrier
 
     void deserialise(byte_fetch& fetch, int num_bytes)
     {
-        objs.clear();
+        erase_all();
 
         for(int i=0; i<num_bytes / (sizeof(vec2f) * 2); i++)
         {
-            physics_barrier* bar = new physics_barrier;
+            physics_barrier* bar = make_new<physics_barrier>();
 
-            bar->deserialise(fetch);
+            if(bar == nullptr)
+            {
+                ///keep reading so the rest of the save still lines up
+                physics_barrier skipped_bar;
+                skipped_bar.deserialise(fetch);
+                continue;
+            }
 
-            objs.push_back(bar);
+            bar->deserialise(fetch);
         }
 
         build_connectivity();
+
+        geometry_dirty = true;
     }
 
     bool any_crosses(vec2f p1, vec2f p2)
@@ -348,34 +364,13 @@ struct physics_barrier_manager : virtual renderable_manager_base<physics_barrier
         return false;
     }
 
-    virtual void render(sf::RenderWindow& win)
+    void get_segments(std::vector<barrier_segment>& out)
     {
-        for(renderable* r : object_manager<physics_barrier>::objs)
-        {
-            r->render(win);
-        }
+        out.clear();
 
-        if(show_normals)
+        for(physics_barrier* bar : objs)
         {
-            for(physics_barrier* bar : objs)
-            {
-                vec2f normal = bar->get_normal();
-
-                sf::RectangleShape rect;
-
-                rect.setSize({20, 2});
-
-                rect.setOrigin({0, 1});
-                rect.setFillColor(sf::Color(255, 100, 100));
-
-                vec2f center = (bar->p1 + bar->p2)/2.f;
-
-                rect.setPosition(center.x(), center.y());
-
-                rect.setRotation(r2d(normal.angle()));
-
-                win.draw(rect);
-            }
+            out.push_back({bar->p1, bar->p2});
         }
     }
 
@@ -411,40 +406,14 @@ struct game_world_manager
     int cur_spawn = 0;
     std::vector<vec2f> spawn_positions;
 
-    bool should_render = false;
+    ///same as physics_barrier_manager::geometry_dirty
+    bool dirty = true;
 
     void add(vec2f pos)
     {
         spawn_positions.push_back(pos);
-    }
-
-    void render(sf::RenderWindow& win)
-    {
-        if(!should_render)
-            return;
 
-        float rad = 8;
-
-        sf::CircleShape circle;
-        circle.setRadius(rad);
-        circle.setOrigin(rad, rad);
-        circle.setFillColor(sf::Color(255, 128, 255));
-
-        for(vec2f& pos : spawn_positions)
-        {
-            circle.setPosition({pos.x(), pos.y()});
-            win.draw(circle);
-        }
-    }
-
-    void enable_rendering()
-    {
-        should_render = true;
-    }
-
-    void disable_rendering()
-    {
-        should_render = false;
+        dirty = true;
     }
 
     vec2f get_next_spawn()
@@ -479,13 +448,303 @@ struct game_world_manager
         {
             spawn_positions.push_back(fetch.get<vec2f>());
         }
+
+        dirty = true;
+    }
+};
+
+///sim -> main thread, the bits of the world drawn outside of the snapshot
+///they hardly ever change, so the sim only copies them in when they do, and the lock is only held for the copy
+struct static_geometry
+{
+    std::mutex lock;
+    std::atomic<uint32_t> version{0};
+
+    std::vector<barrier_segment> barriers;
+    std::vector<vec2f> spawn_positions;
+
+    ///sim thread
+    void publish(physics_barrier_manager& barrier_manage, game_world_manager& world_manage)
+    {
+        if(!barrier_manage.geometry_dirty && !world_manage.dirty)
+            return;
+
+        std::lock_guard<std::mutex> guard(lock);
+
+        barrier_manage.get_segments(barriers);
+        spawn_positions = world_manage.spawn_positions;
+
+        barrier_manage.geometry_dirty = false;
+        world_manage.dirty = false;
+
+        version++;
+    }
+
+    ///main thread, false if nothing's changed since seen_version
+    bool fetch(uint32_t& seen_version, std::vector<barrier_segment>& out_barriers, std::vector<vec2f>& out_spawns)
+    {
+        if(version == seen_version)
+            return false;
+
+        std::lock_guard<std::mutex> guard(lock);
+
+        out_barriers = barriers;
+        out_spawns = spawn_positions;
+
+        seen_version = version;
+
+        return true;
+    }
+};
+
+///main thread only
+///barriers are baked into chunks by midpoint whenever new geometry turns up, and redrawn as is until then
+///so only chunks near the camera get drawn
+struct static_geometry_renderer
+{
+    std::vector<barrier_segment> barriers;
+    std::vector<vec2f> spawn_positions;
+    uint32_t seen_version = 0;
+
+    bool show_normals = false;
+    ///editor only
+    bool show_spawn_points = false;
+
+    std::unordered_map<uint64_t, sf::VertexArray> baked_chunks;
+    float chunk_size = 512.f;
+    ///half the longest barrier, a chunk's geometry can poke this far outside it
+    float chunk_pad = 0.f;
+    bool geometry_dirty = true;
+    bool baked_normals = false;
+
+    void update(static_geometry& geometry)
+    {
+        if(geometry.fetch(seen_version, barriers, spawn_positions))
+            geometry_dirty = true;
+    }
+
+    sf::VertexArray& chunk_for(vec2f pos)
+    {
+        uint64_t key = grid_cell_key(grid_cell(pos.x(), chunk_size), grid_cell(pos.y(), chunk_size));
+
+        auto it = baked_chunks.find(key);
+
+        if(it != baked_chunks.end())
+            return it->second;
+
+        sf::VertexArray& chunk = baked_chunks[key];
+        chunk.setPrimitiveType(sf::Triangles);
+
+        return chunk;
+    }
+
+    static void append_quad(sf::VertexArray& out, vec2f c1, vec2f c2, vec2f c3, vec2f c4, sf::Color col)
+    {
+        out.append(sf::Vertex({c1.x(), c1.y()}, col));
+        out.append(sf::Vertex({c2.x(), c2.y()}, col));
+        out.append(sf::Vertex({c3.x(), c3.y()}, col));
+
+        out.append(sf::Vertex({c1.x(), c1.y()}, col));
+        out.append(sf::Vertex({c3.x(), c3.y()}, col));
+        out.append(sf::Vertex({c4.x(), c4.y()}, col));
+    }
+
+    ///the same 5 wide strip the old per frame RectangleShape drew, off to the left of p1 -> p2
+    static void bake_barrier(sf::VertexArray& out, const barrier_segment& bar)
+    {
+        vec2f dir = (bar.p2 - bar.p1).norm();
+        vec2f perp = {-dir.y(), dir.x()};
+
+        float height = 5.f;
+
+        append_quad(out, bar.p1, bar.p2, bar.p2 + perp * height, bar.p1 + perp * height, sf::Color(255, 255, 255));
+    }
+
+    ///same normal as physics_barrier::get_normal
+    static void bake_normal(sf::VertexArray& out, const barrier_segment& bar)
+    {
+        vec2f normal = -perpendicular((bar.p2 - bar.p1).norm());
+        vec2f perp = {-normal.y(), normal.x()};
+
+        vec2f center = (bar.p1 + bar.p2)/2.f;
+        vec2f tip = center + normal * 20.f;
+
+        append_quad(out, center - perp, tip - perp, tip + perp, center + perp, sf::Color(255, 100, 100));
+    }
+
+    void bake()
+    {
+        baked_chunks.clear();
+        chunk_pad = 0.f;
+
+        for(const barrier_segment& bar : barriers)
+        {
+            vec2f center = (bar.p1 + bar.p2)/2.f;
+
+            ///normals stick out 20, the strip 5
+            chunk_pad = std::max(chunk_pad, (bar.p2 - bar.p1).length()/2.f + 20.f);
+
+            bake_barrier(chunk_for(center), bar);
+        }
+
+        ///second pass so normals still draw on top of every barrier in the chunk
+        if(show_normals)
+        {
+            for(const barrier_segment& bar : barriers)
+            {
+                bake_normal(chunk_for((bar.p1 + bar.p2)/2.f), bar);
+            }
+        }
+
+        baked_normals = show_normals;
+        geometry_dirty = false;
+    }
+
+    void render(sf::RenderWindow& win, vec2f tl, vec2f br)
+    {
+        if(geometry_dirty || baked_normals != show_normals)
+            bake();
+
+        visit_cells(baked_chunks, chunk_size, chunk_pad, tl, br, [&](const sf::VertexArray& chunk)
+        {
+            win.draw(chunk);
+        });
+
+        if(!show_spawn_points)
+            return;
+
+        float rad = 8;
+
+        sf::CircleShape circle;
+        circle.setRadius(rad);
+        circle.setOrigin(rad, rad);
+        circle.setFillColor(sf::Color(255, 128, 255));
+
+        for(vec2f& pos : spawn_positions)
+        {
+            if(pos.x() + rad < tl.x() || pos.y() + rad < tl.y() || pos.x() - rad > br.x() || pos.y() - rad > br.y())
+                continue;
+
+            circle.setPosition({pos.x(), pos.y()});
+            win.draw(circle);
+        }
     }
 };
 
 #include "character.hpp"
 
+///editor -> sim. The editor never touches the world itself, the sim applies these at the start of its next step
+struct sim_command
+{
+    enum type
+    {
+        ADD_BARRIER_POINT,
+        ADD_SPAWN_POINT,
+        SPAWN_OBJECT,
+        STEP, ///single step while in edit mode
+        SAVE,
+        LOAD,
+    };
+
+    type t = STEP;
+    vec2f pos = {0,0};
+
+    ///SPAWN_OBJECT only. Without apply_params the object keeps its defaults, like the plain spawn tool always has
+    bool apply_params = false;
+    ///0 -> solid, 1 -> liquid, 2 -> gas
+    int phase = 0;
+    bool fixed = false;
+    particle_parameters params;
+};
+
+void save(const std::string& file, physics_barrier_manager& physics_barrier_manage, game_world_manager& game_world_manage);
+void load(const std::string& file, physics_barrier_manager& physics_barrier_manage, game_world_manager& game_world_manage);
+
+///sim thread
+void apply_sim_command(const sim_command& cmd, state& st, int& step_requests)
+{
+    if(cmd.t == sim_command::ADD_BARRIER_POINT)
+    {
+        st.physics_barrier_manage.add_point(cmd.pos, st);
+    }
+
+    if(cmd.t == sim_command::ADD_SPAWN_POINT)
+    {
+        st.game_world_manage.add(cmd.pos);
+    }
+
+    if(cmd.t == sim_command::SPAWN_OBJECT)
+    {
+        physics_object_host* c = dynamic_cast<physics_object_host*>(st.physics_object_manage.make_new<physics_object_host>(1, st.net_state));
+
+        if(c == nullptr)
+            return;
+
+        c->transform().pos = cmd.pos;
+        c->last_pos = cmd.pos;
+        c->init_collision_pos(cmd.pos);
+
+        if(!cmd.apply_params)
+            return;
+
+        if(cmd.phase == 0)
+        {
+            c->is_solid = true;
+        }
+        else if(cmd.phase == 1)
+        {
+            c->is_solid = false;
+        }
+        else if(cmd.phase == 2)
+        {
+            c->is_solid = false;
+            c->is_gas = true;
+        }
+
+        c->params = cmd.params;
+        c->fixed = cmd.fixed;
+
+        c->sync_render_component();
+    }
+
+    if(cmd.t == sim_command::STEP)
+    {
+        step_requests++;
+    }
+
+    if(cmd.t == sim_command::SAVE)
+    {
+        save("file.mapfile", st.physics_barrier_manage, st.game_world_manage);
+    }
+
+    if(cmd.t == sim_command::LOAD)
+    {
+        load("file.mapfile", st.physics_barrier_manage, st.game_world_manage);
+    }
+}
+
+///runs on the main thread alongside imgui, anything that changes the world goes to the sim as a sim_command
 struct debug_controls
 {
+    spsc_queue<sim_command>& commands;
+
+    debug_controls(spsc_queue<sim_command>& pcommands) : commands(pcommands) {}
+
+    void send(sim_command&& cmd)
+    {
+        if(!commands.push(std::move(cmd)))
+            printf("editor command queue full, dropping\n");
+    }
+
+    void send_barrier_point(vec2f pos)
+    {
+        sim_command cmd;
+        cmd.t = sim_command::ADD_BARRIER_POINT;
+        cmd.pos = pos;
+
+        send(std::move(cmd));
+    }
+
     int controls_state = 0;
 
     int tools_state = 0;
@@ -506,25 +765,29 @@ struct debug_controls
         }
     }
 
-    void line_draw_controls(vec2f mpos, state& st)
+    void line_draw_controls(vec2f mpos)
     {
         if(suppress_mouse)
             return;
 
         if(ONCE_MACRO(sf::Mouse::Left))
         {
-            st.physics_barrier_manage.add_point(mpos, st);
+            send_barrier_point(mpos);
         }
     }
 
-    void spawn_controls(vec2f mpos, state& st)
+    void spawn_controls(vec2f mpos)
     {
         if(suppress_mouse)
             return;
 
         if(ONCE_MACRO(sf::Mouse::Left))
         {
-            st.game_world_manage.add(mpos);
+            sim_command cmd;
+            cmd.t = sim_command::ADD_SPAWN_POINT;
+            cmd.pos = mpos;
+
+            send(std::move(cmd));
         }
     }
 
@@ -575,7 +838,7 @@ struct debug_controls
     vec2f last_drag_pos;
     bool has_last_drag = false;
 
-    void drag_line_tool(vec2f mpos, state& st)
+    void drag_line_tool(vec2f mpos)
     {
         if(suppress_mouse)
             return;
@@ -593,8 +856,8 @@ struct debug_controls
 
         if(has_last_drag && (mpos - last_drag_pos).length() > plonk_distance)
         {
-            st.physics_barrier_manage.add_point(last_drag_pos, st);
-            st.physics_barrier_manage.add_point(mpos, st);
+            send_barrier_point(last_drag_pos);
+            send_barrier_point(mpos);
 
             last_drag_pos = mpos;
         }
@@ -608,7 +871,7 @@ struct debug_controls
     vec2f last_pos;
     bool has_last = false;
 
-    void connected_line_tool(vec2f mpos, state& st)
+    void connected_line_tool(vec2f mpos)
     {
         if(suppress_mouse)
             return;
@@ -619,8 +882,8 @@ struct debug_controls
         {
             if(has_last)
             {
-                st.physics_barrier_manage.add_point(last_pos, st);
-                st.physics_barrier_manage.add_point(mpos, st);
+                send_barrier_point(last_pos);
+                send_barrier_point(mpos);
             }
 
             has_last = true;
@@ -659,7 +922,8 @@ struct debug_controls
         ImGui::End();
     }
 
-    physics_object_host* spawn(vec2f mpos, state& st, float spacing, int phase)
+    ///true if it sent one
+    bool spawn(vec2f mpos, float spacing, int phase, bool fixed)
     {
         sf::Mouse mouse;
 
@@ -675,63 +939,49 @@ struct debug_controls
 
             if(dist.length() > spacing)
             {
-                physics_object_host* c = dynamic_cast<physics_object_host*>(st.physics_object_manage.make_new<physics_object_host>(1, st.net_state));
-
-                c->pos = mpos;
-                c->last_pos = c->pos;
-                c->init_collision_pos(c->pos);
-
-                if(phase == 0)
-                {
-                    c->is_solid = true;
-                }
-                else if(phase == 1)
-                {
-                    c->is_solid = false;
-                }
-                else if(phase == 2)
-                {
-                    c->is_solid = false;
-                    c->is_gas = true;
-                }
+                sim_command cmd;
+                cmd.t = sim_command::SPAWN_OBJECT;
+                cmd.pos = mpos;
+                cmd.apply_params = true;
+                cmd.phase = phase;
+                cmd.fixed = fixed;
+                cmd.params = params;
 
-                c->params = params;
+                send(std::move(cmd));
 
                 last_spawn_pos = mpos;
 
-                return c;
+                return true;
             }
         }
 
-        return nullptr;
+        return false;
     }
 
-    void spawn_continuous(vec2f mpos, state& st)
+    void spawn_continuous(vec2f mpos)
     {
         if(suppress_mouse)
             return;
 
-        spawn(mpos, st, 20, matter_phase);
+        spawn(mpos, 20, matter_phase, false);
     }
 
-    void spawn_continuous_fixed(vec2f mpos, state& st)
+    void spawn_continuous_fixed(vec2f mpos)
     {
         if(suppress_mouse)
             return;
 
-        auto ptr = spawn(mpos, st, 40, matter_phase);
-
-        if(ptr == nullptr)
-            return;
-
-        ptr->fixed = true;
+        spawn(mpos, 40, matter_phase, true);
     }
 
     bool show_normals = false;
 
-    void editor_controls(vec2f mpos, state& st)
+    ///read by static_geometry_renderer
+    bool show_spawn_points = false;
+
+    void editor_controls(vec2f mpos)
     {
-        st.game_world_manage.enable_rendering();
+        show_spawn_points = true;
 
         ImGui::Begin("Tools", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
 
@@ -754,59 +1004,57 @@ struct debug_controls
 
         if(tools_state == 0)
         {
-            line_draw_controls(mpos, st);
+            line_draw_controls(mpos);
         }
 
         if(tools_state == 1)
         {
-            spawn_controls(mpos, st);
+            spawn_controls(mpos);
         }
 
         if(tools_state == 2)
         {
-            connected_line_tool(mpos, st);
+            connected_line_tool(mpos);
         }
 
         if(tools_state == 3)
         {
-            drag_line_tool(mpos, st);
+            drag_line_tool(mpos);
         }
 
         /*if(ImGui::Button("Spawn"))
         {
             physics_object_host* c = dynamic_cast<physics_object_host*>(st.physics_object_manage.make_new<physics_object_host>(1, st.net_state));
 
-            c->pos = mpos;
-            c->last_pos = c->pos;
-            c->init_collision_pos(c->pos);
+            c->transform().pos = mpos;
+            c->last_pos = mpos;
+            c->init_collision_pos(mpos);
         }*/
 
         if(tools_state == 4)
         {
             if(ONCE_MACRO(sf::Mouse::Left) && !suppress_mouse)
             {
-                physics_object_host* c = dynamic_cast<physics_object_host*>(st.physics_object_manage.make_new<physics_object_host>(1, st.net_state));
+                sim_command cmd;
+                cmd.t = sim_command::SPAWN_OBJECT;
+                cmd.pos = mpos;
 
-                c->pos = mpos;
-                c->last_pos = c->pos;
-                c->init_collision_pos(c->pos);
+                send(std::move(cmd));
             }
         }
 
         if(tools_state == 5)
         {
-            spawn_continuous(mpos, st);
+            spawn_continuous(mpos);
         }
 
         if(tools_state == 6)
         {
-            spawn_continuous_fixed(mpos, st);
+            spawn_continuous_fixed(mpos);
         }
 
         ImGui::Checkbox("Show normals", &show_normals);
 
-        st.physics_barrier_manage.show_normals = show_normals;
-
         if(ImGui::Button("Solid"))
         {
             matter_phase = 0;
@@ -830,11 +1078,9 @@ struct debug_controls
         param_editor();
     }
 
-    void tick(state& st)
+    void tick(vec2f mpos)
     {
-        vec2f mpos = st.cam.get_mouse_position_world();
-
-        st.game_world_manage.disable_rendering();
+        show_spawn_points = false;
 
         ImGui::Begin("Control menus");
 
@@ -857,10 +1103,33 @@ struct debug_controls
 
         if(controls_state == 0)
         {
-            editor_controls(mpos, st);
+            editor_controls(mpos);
         }
 
         ImGui::End();
+
+        if(controls_state == 0)
+        {
+            ImGui::Begin("Save/Load");
+
+            if(ImGui::Button("Save"))
+            {
+                sim_command cmd;
+                cmd.t = sim_command::SAVE;
+
+                send(std::move(cmd));
+            }
+
+            if(ImGui::Button("Load"))
+            {
+                sim_command cmd;
+                cmd.t = sim_command::LOAD;
+
+                send(std::move(cmd));
+            }
+
+            ImGui::End();
+        }
     }
 };
 
@@ -905,15 +1174,13 @@ byte_fetch get_file(const std::string& fname)
     return ret;
 }
 
-void load(const std::string& file, physics_barrier_manager& physics_barrier_manage, game_world_manager& game_world_manage, renderable_manager& renderable_manage)
+void load(const std::string& file, physics_barrier_manager& physics_barrier_manage, game_world_manager& game_world_manage)
 {
     byte_fetch fetch = get_file(file);
 
     int32_t v1_s = fetch.get<int32_t>();
     int32_t v2_s = fetch.get<int32_t>();
 
-    renderable_manage.erase_all();
-
     physics_barrier_manage.deserialise(fetch, v1_s);
     game_world_manage.deserialise(fetch, v2_s);
 }
@@ -927,10 +1194,12 @@ int main()
     sf::RenderWindow win;
     win.create(sf::VideoMode(1500, 1000), "fak u mark", sf::Style::Default, context);
 
+    ///display() paces the render loop, the sim runs on its own clock so we don't need to sleep
+    win.setVerticalSyncEnabled(true);
+
     ImGui::SFML::Init(win);
     ImGui::NewFrame();
 
-    renderable_manager renderable_manage;
     physics_object_manager physics_object_manage;
 
     physics_barrier_manager physics_barrier_manage;
@@ -942,23 +1211,208 @@ int main()
 
     network_state net_state;
 
-    debug_controls controls;
+    ///main thread -> sim
+    spsc_queue<sim_command> sim_commands(1024);
+
+    debug_controls controls(sim_commands);
+
+    static_geometry geometry;
+    static_geometry_renderer geometry_renderer;
 
-    state st(physics_object_manage, physics_barrier_manage, game_world_manage, renderable_manage, projectile_manage, cam, net_state, win);
+    movement_system movement_sys;
+    collision_system collision_sys;
+    network_system network_sys;
+    interpolation_system interpolation_sys;
+    render_system render_sys;
+
+    state st(physics_object_manage, physics_barrier_manage, game_world_manage, projectile_manage, cam, net_state, win);
 
     st.physics_object_manage.system_network_id = 0;
     st.physics_barrier_manage.system_network_id = 1;
     st.game_world_manage.system_network_id = 2;
-    st.renderable_manage.system_network_id = 3;
     st.projectile_manage.system_network_id = 4;
 
     ///-2 team bit of a hack, objects default to -1
     //player_character* test = dynamic_cast<player_character*>(character_manage.make_new<player_character>(-2, st.net_state));
 
-    load("file.mapfile", physics_barrier_manage, game_world_manage, renderable_manage);
-    //renderable_manage.add(test);
+    load("file.mapfile", physics_barrier_manage, game_world_manage);
+
+    ///the sim owns the world and steps it on its own thread at a fixed rate
+    ///the main thread handles input, the editor and rendering, drawing from snapshots the sim publishes
+    ///the editor never touches the world, it sends sim_commands, so neither thread ever waits on the other's step
+    std::atomic_bool sim_running{true};
+    std::atomic_int sim_controls_state{controls.controls_state};
+
+    ///camera rect the sim should snapshot around, written by the main thread
+    std::mutex view_lock;
+    vec2f shared_view_tl = {0,0};
+    vec2f shared_view_br = {0,0};
+
+    triple_buffer<render_snapshot> snapshots;
+
+    float sim_dt_s = 1/60.f;
+
+    net_state.io.start();
+
+    std::thread sim_thread([&]()
+    {
+        profiler::set_thread_name("sim");
+
+        snapshot_system snapshot_sys;
+
+        sf::Clock sim_clk;
+
+        float accumulated = 0.f;
+
+        uint32_t frame = 0;
+
+        ///space in edit mode, a single step per request
+        int sim_step_requests = 0;
+
+        sim_command cmd;
+
+        while(sim_running)
+        {
+            accumulated += sim_clk.restart().asMicroseconds() / 1000.f / 1000.f;
+
+            if(accumulated < sim_dt_s)
+            {
+                sf::sleep(sf::milliseconds(1));
+                continue;
+            }
+
+            accumulated -= sim_dt_s;
+
+            ///if we've fallen miles behind don't try and catch up, same as the old dt clamp
+            if(accumulated > sim_dt_s * 4)
+                accumulated = 0.f;
+
+            float dt_s = sim_dt_s;
+
+            {
+                PROFILE_SCOPE("sim_step");
+
+                {
+                    PROFILE_SCOPE("sim_commands");
+
+                    while(sim_commands.pop(cmd))
+                    {
+                        apply_sim_command(cmd, st, sim_step_requests);
+                    }
+
+                    geometry.publish(physics_barrier_manage, game_world_manage);
+                }
+
+                st.dt_s = dt_s;
+
+                if(sim_controls_state == 1)
+                {
+                    if(frame > 1)
+                    {
+                        {
+                            PROFILE_SCOPE("tick");
+
+                            physics_object_manage.tick(dt_s, st);
+                        }
+
+                        {
+                            PROFILE_SCOPE("check_interaction");
+
+                            physics_object_manage.check_interaction(dt_s, st, physics_object_manage);
+                        }
+
+                        {
+                            PROFILE_SCOPE("resolve_barrier_collisions");
+
+                            physics_object_manage.resolve_barrier_collisions(dt_s, st);
+                        }
+                    }
+
+                    PROFILE_SCOPE("movement_projectiles");
+
+                    movement_sys.tick(dt_s);
+
+                    projectile_manage.tick(dt_s, st);
+                }
+
+                if(sim_controls_state == 0)
+                {
+                    if(frame > 1 && sim_step_requests > 0)
+                    {
+                        sim_step_requests--;
+
+                        physics_object_manage.tick(dt_s, st);
+
+                        physics_object_manage.check_interaction(dt_s, st, physics_object_manage);
+
+                        physics_object_manage.resolve_barrier_collisions(dt_s, st);
+                    }
+                }
+
+                {
+                    PROFILE_SCOPE("net_state_tick");
+
+                    net_state.tick_cleanup();
+                    net_state.tick();
+                }
+
+                {
+                    PROFILE_SCOPE("collisions");
+
+                    collision_sys.check_collisions(st, collide::PROJECTILE, collide::PARTICLE);
+                    collision_sys.check_collisions(st, collide::PROJECTILE, collide::BARRIER);
+                }
+
+                {
+                    PROFILE_SCOPE("networking");
+
+                    ///existing objects claim their messages first, whatever's left creates new ones
+                    network_sys.tick(net_state);
+
+                    projectile_manage.tick_create_networking<projectile>(net_state);
+                    physics_object_manage.tick_create_networking<physics_object_client>(net_state);
+                }
+
+                {
+                    PROFILE_SCOPE("interpolation");
+
+                    interpolation_sys.tick(net_state.now_s());
+                }
+
+                {
+                    PROFILE_SCOPE("cleanup");
+
+                    projectile_manage.cleanup(st);
+                }
+
+                PROFILE_SCOPE("snapshot");
+
+                vec2f tl, br;
+
+                {
+                    std::lock_guard<std::mutex> view_guard(view_lock);
+
+                    tl = shared_view_tl;
+                    br = shared_view_br;
+                }
+
+                net_state.report_view(tl, br);
+
+                ///the camera can move before the next snapshot lands, grab a bit extra
+                vec2f pad = (br - tl) * 0.25f;
+
+                snapshot_sys.build(snapshots.write_buffer(), frame, tl - pad, br + pad);
+            }
+
+            snapshots.publish();
+
+            frame++;
+        }
+    });
 
     sf::Clock clk;
+    ///time since the newest snapshot arrived, drives interpolation
+    sf::Clock snapshot_clk;
 
     sf::Keyboard key;
     sf::Mouse mouse;
@@ -967,21 +1421,18 @@ int main()
 
     uint32_t frame = 0;
 
+    profiler::set_thread_name("main");
+
+    profiler_panel profile_panel;
+
     while(win.isOpen())
     {
+        PROFILE_SCOPE("frame");
+
         auto sfml_mpos = mouse.getPosition(win);
 
         vec2f mpos = {sfml_mpos.x, sfml_mpos.y};
 
-        float dt_s = (clk.restart().asMicroseconds() / 1000.) / 1000.f;
-
-        if(dt_s > 1/33.f)
-        {
-            dt_s = 1/33.f;
-        }
-
-        st.dt_s = dt_s;
-
         sf::Event event;
 
         float scrollwheel_delta = 0;
@@ -1038,80 +1489,68 @@ int main()
             }
         }
 
-        controls.tick(st);
-
-        if(controls.controls_state == 0)
         {
-            ImGui::Begin("Save/Load");
+            PROFILE_SCOPE("editor");
 
-            if(ImGui::Button("Save"))
-            {
-                save("file.mapfile", physics_barrier_manage, game_world_manage);
-            }
-
-            if(ImGui::Button("Load"))
-            {
-                load("file.mapfile", physics_barrier_manage, game_world_manage, renderable_manage);
-            }
-
-            ImGui::End();
+            controls.tick(cam.get_mouse_position_world());
         }
 
-        if(controls.controls_state == 1)
-        {
-            if(frame > 1)
-            {
-                physics_object_manage.tick(dt_s, st);
-
-                physics_object_manage.check_interaction(dt_s, st, physics_object_manage);
-
-                physics_object_manage.resolve_barrier_collisions(dt_s, st);
-            }
-
-            projectile_manage.tick(dt_s, st);
-        }
+        sim_controls_state = controls.controls_state;
 
         if(controls.controls_state == 0)
         {
             if(frame > 1 && ONCE_MACRO(sf::Keyboard::Space))
             {
-                physics_object_manage.tick(dt_s, st);
-
-                physics_object_manage.check_interaction(dt_s, st, physics_object_manage);
+                sim_command step;
+                step.t = sim_command::STEP;
 
-                physics_object_manage.resolve_barrier_collisions(dt_s, st);
+                controls.send(std::move(step));
             }
         }
 
-        net_state.tick_cleanup();
-        net_state.tick_join_game(dt_s);
-        net_state.tick();
+        cam.update_camera();
 
-        projectile_manage.check_collisions(st, physics_object_manage);
-        projectile_manage.check_collisions(st, physics_barrier_manage);
+        vec2f view_tl, view_br;
+        cam.get_visible_rect(view_tl, view_br);
 
-        projectile_manage.tick_all_networking<projectile_manager, projectile>(net_state);
-        physics_object_manage.tick_all_networking<physics_object_manager, physics_object_client>(net_state);
+        {
+            std::lock_guard<std::mutex> view_guard(view_lock);
 
-        cam.update_camera();
+            shared_view_tl = view_tl;
+            shared_view_br = view_br;
+        }
+
+        if(snapshots.acquire())
+            snapshot_clk.restart();
 
-        projectile_manage.cleanup(st);
+        float alpha = (snapshot_clk.getElapsedTime().asMicroseconds() / 1000.f / 1000.f) / sim_dt_s;
 
-        renderable_manage.render(win);
-        physics_barrier_manage.render(win);
-        game_world_manage.render(win);
-        projectile_manage.render(win);
-        physics_object_manage.render(win);
+        alpha = std::min(std::max(alpha, 0.f), 1.f);
 
+        profile_panel.render();
 
-        ImGui::Render();
-        win.display();
-        win.clear();
+        {
+            PROFILE_SCOPE("render");
 
-        sf::sleep(sf::milliseconds(1));
+            geometry_renderer.show_normals = controls.show_normals;
+            geometry_renderer.show_spawn_points = controls.show_spawn_points;
+
+            geometry_renderer.update(geometry);
+            geometry_renderer.render(win, view_tl, view_br);
+            render_sys.render(win, snapshots.read_buffer(), alpha, view_tl, view_br);
+
+            ImGui::Render();
+            win.display();
+            win.clear();
+        }
 
         frame++;
     }
 
+    sim_running = false;
+    sim_thread.join();
+
+    net_state.io.stop();
+
     return 0;
 }
@@ -1,3 +1,3 @@
 #include "managers.hpp"
 
-uint16_t o_id = 0;
+entity_store entities;
@@ -3,18 +3,15 @@
 
 #include <stdint.h>
 #include <vector>
+#include <unordered_map>
+#include <utility>
 #include "networking.hpp"
 #include "networkable_systems.hpp"
 
-struct renderable;
 struct projectile;
 struct state;
 struct network_state;
 
-///shared state
-///every object has a unique id globally
-extern uint16_t o_id;
-
 template<typename T>
 struct object_manager
 {
@@ -22,184 +19,123 @@ struct object_manager
 
     std::vector<T*> objs;
 
-    template<typename real_type, typename... U>
-    T* make_new(U... u)
-    {
-        T* nt = new real_type(u...);
-
-        nt->object_id = o_id++;
-
-        objs.push_back(nt);
+    ///(ownership_class, object_id) -> object, kept in step with objs
+    std::unordered_map<uint64_t, T*> network_index;
 
-        return nt;
+    static uint64_t network_key(uint32_t object_id, int32_t ownership_class)
+    {
+        return ((uint64_t)(uint16_t)ownership_class << 32) | object_id;
     }
 
-    void destroy(T* t)
+    ///forwarded, network_state in particular can't be copied
+    ///nullptr if the entity store is full, callers have to check
+    template<typename real_type, typename... U>
+    T* make_new(U&&... u)
     {
-        for(int i=0; i<objs.size(); i++)
-        {
-            if(objs[i] == t)
-            {
-                objs.erase(objs.begin() + i);
-                i--;
+        T* nt = new real_type(std::forward<U>(u)...);
 
-                delete t;
-                continue;
-            }
+        if(!entities.alive(nt->entity))
+        {
+            delete nt;
+            return nullptr;
         }
+
+        if(entities.networks.has(nt->entity))
+            entities.networks.get(nt->entity).system_network_id = system_network_id;
+
+        add(nt);
+
+        return nt;
     }
 
     void add(T* t)
     {
         objs.push_back(t);
-    }
 
-    void rem(T* t)
-    {
-        for(int i=0; i<objs.size(); i++)
-        {
-            if(objs[i] == t)
-            {
-                objs.erase(objs.begin() + i);
-                i--;
-            }
-        }
+        network_index[network_key(t->object_id, t->ownership_class)] = t;
     }
 
     void erase_all()
     {
-        /*for(auto& i : objs)
+        for(auto& i : objs)
         {
             delete i;
-        }*/
+        }
 
         objs.clear();
+        network_index.clear();
     }
 
+    ///objects own their entity, so cleaned up objects have to be deleted
+    ///or their components would keep being rendered/collided
+    ///single compaction pass, keeps order and stays linear however many objects go
+    ///on_cleanup can make_new into this manager, which is why this indexes rather than iterates
     void cleanup(state& st)
     {
+        int next = 0;
+
         for(int i=0; i<objs.size(); i++)
         {
-            if(objs[i]->should_cleanup)
+            T* t = objs[i];
+
+            if(t->should_cleanup)
             {
-                objs[i]->on_cleanup(st);
+                t->on_cleanup(st);
 
-                objs.erase(objs.begin() + i);
-                i--;
+                unindex(t);
+
+                delete t;
 
                 continue;
             }
-        }
-    }
 
-    bool owns(int id, int32_t ownership_class)
-    {
-        for(auto& i : objs)
-        {
-            if(i->object_id == id && i->ownership_class == ownership_class)
-                return true;
+            objs[next++] = t;
         }
 
-        return false;
+        objs.resize(next);
     }
-};
 
-template<typename T>
-struct network_manager_base : virtual object_manager<T>
-{
-    ///real type is the type to create if we receive a new networked entity
-    template<typename manager_type, typename real_type>
-    void tick_create_networking(network_state& ns)
+    void unindex(T* t)
     {
-        manager_type* type = dynamic_cast<manager_type*>(this);
+        auto it = network_index.find(network_key(t->object_id, t->ownership_class));
 
-        ///when reading this, ignore the template keyword
-        ///its because this is a dependent type
-        ns.template check_create_network_entity<manager_type, real_type>(*type);
+        if(it != network_index.end() && it->second == t)
+            network_index.erase(it);
     }
 
-    void update_network_entities(network_state& ns)
+    ///replicas take on the id and owner of whoever sent them, which changes their key
+    void set_network_identity(T* t, uint32_t object_id, int32_t ownership_class)
     {
-        for(T* obj : object_manager<T>::objs)
-        {
-            networkable_host* host_object = dynamic_cast<networkable_host*>(obj);
-
-            if(host_object != nullptr)
-            {
-                host_object->update(ns, object_manager<T>::system_network_id);
-                host_object->process_recv(ns);
-            }
+        unindex(t);
 
-            networkable_client* client_object = dynamic_cast<networkable_client*>(obj);
+        t->object_id = object_id;
+        t->ownership_class = ownership_class;
 
-            if(client_object != nullptr)
-            {
-                client_object->update(ns, object_manager<T>::system_network_id);
-                client_object->process_recv(ns);
-            }
-        }
+        network_index[network_key(object_id, ownership_class)] = t;
     }
 
-    template<typename manager_type, typename real_type>
-    void tick_all_networking(network_state& ns)
+    T* find(uint32_t id, int32_t ownership_class)
     {
-        tick_create_networking<manager_type, real_type>(ns);
+        auto it = network_index.find(network_key(id, ownership_class));
 
-        update_network_entities(ns);
-    }
+        if(it == network_index.end())
+            return nullptr;
 
-    virtual ~network_manager_base(){}
-};
+        return it->second;
+    }
 
-template<typename T>
-struct renderable_manager_base : virtual object_manager<T>
-{
-    virtual void render(sf::RenderWindow& win)
+    bool owns(uint32_t id, int32_t ownership_class)
     {
-        for(renderable* r : object_manager<T>::objs)
-        {
-            r->render(win);
-        }
+        return find(id, ownership_class) != nullptr;
     }
-};
-
-struct renderable_manager : virtual renderable_manager_base<renderable>
-{
-
-};
 
-template<typename T>
-struct collideable_manager_base : virtual object_manager<T>
-{
-    template<typename U>
-    void check_collisions(state& st, collideable_manager_base<U>& other)
+    ///real type is the type to create if we receive a new networked entity
+    template<typename real_type>
+    void tick_create_networking(network_state& ns)
     {
-        for(int i=0; i<object_manager<T>::objs.size(); i++)
-        {
-            T* my_t = object_manager<T>::objs[i];
-
-            for(int j=0; j<other.objs.size(); j++)
-            {
-                U* their_t = other.objs[j];
-
-                /*if(my_t->intersects(their_t))
-                {
-                    printf("%i %i\n", my_t->team, their_t->team);
-                }*/
-
-                if(!my_t->can_collide() || !their_t->can_collide())
-                    continue;
-
-                if((void*)my_t == (void*)their_t)
-                    continue;
-
-                if(my_t->intersects(their_t))
-                {
-                    my_t->on_collide(st, their_t);
-                    their_t->on_collide(st, my_t);
-                }
-            }
-        }
+        ///when reading this, ignore the template keyword
+        ///its because this is a dependent type
+        ns.template check_create_network_entity<object_manager<T>, real_type>(*this);
     }
 };
 
@@ -236,38 +172,7 @@ struct timestep_state
     }
 };
 
-template<typename T>
-struct chemical_interaction_base : virtual object_manager<T>
-{
-    timestep_state fts;
-
-    template<typename U>
-    void check_interaction(float dt_s, state& st, chemical_interaction_base<U>& other)
-    {
-        int nsteps = fts.step(dt_s);
-
-        for(int kk=0; kk < nsteps; kk++)
-        {
-            for(int i=0; i<object_manager<T>::objs.size(); i++)
-            {
-                T* my_t = object_manager<T>::objs[i];
-
-                my_t->interact(fts.get_max_step(dt_s), other, st);
-            }
-        }
-
-        /*cur_timestep = clamp(cur_timestep, 0.00001f, max_timestep);
-
-        for(int i=0; i<object_manager<T>::objs.size(); i++)
-        {
-            T* my_t = object_manager<T>::objs[i];
-
-            my_t->interact(cur_timestep, other);
-        }*/
-    }
-};
-
-struct projectile_manager : virtual renderable_manager_base<projectile_base>, virtual collideable_manager_base<projectile_base>, virtual network_manager_base<projectile_base>
+struct projectile_manager : object_manager<projectile_base>
 {
     void tick(float dt_s, state& st)
     {
@@ -0,0 +1,229 @@
+#ifndef NETWORK_IO_HPP_INCLUDED
+#define NETWORK_IO_HPP_INCLUDED
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <SFML/System.hpp>
+
+#include "2d_quacku_servers/master_server/network_messages.hpp"
+#include "2d_quacku_servers/batch_io_shared.hpp"
+#include "2d_quacku_servers/wire_protocol_shared.hpp"
+#include "2d_quacku_servers/profiler_shared.hpp"
+
+#include "packet_view.hpp"
+#include "spsc_queue.hpp"
+
+inline
+udp_sock join_game(const std::string& address, const std::string& port)
+{
+    udp_sock sock = udp_connect(address, port);
+
+    byte_vector vec;
+    wire::start_datagram(vec);
+    size_t body = wire::begin(vec, message::CLIENTJOINREQUEST);
+    wire::end(vec, body);
+
+    udp_send(sock, vec.ptr);
+
+    return sock;
+}
+
+///one message off the wire, the body can't be read past the end of the message
+struct inbound_message
+{
+    uint32_t type = 0;
+    packet_view body;
+};
+
+///owns the game server socket, and does all the receiving, parsing and sending on its own thread
+///the game thread only ever sees parsed messages coming in, and hands over finished datagrams going out
+///so a slow sendto or a burst of packets never lands in a sim tick
+struct network_io
+{
+    std::thread thread;
+    std::atomic_bool running{false};
+
+    ///set when the server acks our join, -1 until then
+    std::atomic_int my_id{-1};
+    std::atomic_bool leave_requested{false};
+
+    ///io thread -> game thread
+    spsc_queue<inbound_message> received{4096};
+    ///game thread -> io thread
+    spsc_queue<std::vector<char>> to_send{256};
+    ///io thread -> game thread, sent buffers handed back so building the next datagram doesn't allocate
+    spsc_queue<std::vector<char>> spare{256};
+
+    ///everything below is only touched by the io thread
+    udp_sock sock;
+    sockaddr_storage store;
+
+    recv_ring receive_ring;
+    datagram_batch outgoing;
+
+    sf::Clock join_clk;
+    float join_retry_s = 5.f;
+    bool tried_join = false;
+
+    ///read from both threads, only ever read
+    sf::Clock clk;
+
+    float now_s() const
+    {
+        return clk.getElapsedTime().asMicroseconds() / 1000.f / 1000.f;
+    }
+
+    void start()
+    {
+        if(running)
+            return;
+
+        running = true;
+
+        thread = std::thread([this](){run();});
+    }
+
+    void stop()
+    {
+        running = false;
+
+        if(thread.joinable())
+            thread.join();
+    }
+
+    ~network_io()
+    {
+        stop();
+    }
+
+    void run()
+    {
+        profiler::set_thread_name("network");
+
+        while(running)
+        {
+            tick_join();
+
+            int num_received = receive();
+            int num_sent = send();
+
+            if(num_received == 0 && num_sent == 0)
+                sf::sleep(sf::milliseconds(1));
+        }
+
+        sock.close();
+    }
+
+    void tick_join()
+    {
+        if(leave_requested.exchange(false))
+        {
+            sock.close();
+
+            my_id = -1;
+        }
+
+        if(my_id != -1)
+            return;
+
+        if(tried_join && join_clk.getElapsedTime().asSeconds() < join_retry_s)
+            return;
+
+        if(sock.valid())
+            sock.close();
+
+        sock = join_game("127.0.0.1", GAMESERVER_PORT);
+
+        join_clk.restart();
+        tried_join = true;
+    }
+
+    int receive()
+    {
+        if(!sock.valid())
+            return 0;
+
+        int total = 0;
+        int num_received = 0;
+
+        while((num_received = receive_ring.receive(sock)) > 0)
+        {
+            for(int slot=0; slot < num_received; slot++)
+            {
+                store = receive_ring.addrs[slot];
+
+                parse(slot);
+            }
+
+            total += num_received;
+        }
+
+        return total;
+    }
+
+    ///views hold the ring buffer alive until the game thread's done with them
+    ///the ring swaps in a fresh buffer if they're still around next time
+    void parse(int slot)
+    {
+        packet_view fetch(receive_ring.buffers[slot], receive_ring.lengths[slot]);
+        fetch.received_s = now_s();
+
+        if(wire::detect_version(fetch.data(), fetch.remaining()) != WIRE_VERSION)
+        {
+            printf("dropping datagram not in protocol version %i\n", WIRE_VERSION);
+            return;
+        }
+
+        fetch.counter = wire::header_size;
+
+        uint32_t type = 0;
+        uint32_t len = 0;
+
+        while(wire::next_message(fetch, type, len))
+        {
+            packet_view body = fetch.slice(len);
+
+            ///session state, the game thread only needs the result
+            if(type == message::CLIENTJOINACK)
+            {
+                my_id = body.get<int32_t>();
+                continue;
+            }
+
+            inbound_message msg;
+            msg.type = type;
+            msg.body = std::move(body);
+
+            if(!received.push(std::move(msg)))
+                printf("network receive queue full, dropping type %u\n", type);
+        }
+    }
+
+    int send()
+    {
+        int num = 0;
+
+        std::vector<char> data;
+
+        while(to_send.pop(data))
+        {
+            if(sock.valid())
+                outgoing.add(sock, store, data);
+
+            data.clear();
+
+            ///if the game thread isn't taking them back, it'll just allocate
+            spare.push(std::move(data));
+
+            num++;
+        }
+
+        if(num > 0)
+            outgoing.flush();
+
+        return num;
+    }
+};
+
+#endif // NETWORK_IO_HPP_INCLUDED
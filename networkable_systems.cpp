@@ -2,18 +2,29 @@
 #include "state.hpp"
 #include "managers.hpp"
 
+///make_new adds components, so grab our position before it can move under us
 void projectile::on_cleanup(state& st)
 {
+    vec2f pos = transform().pos;
+
     auto proj = st.projectile_manage.make_new<explosion_projectile_client>();
 
-    proj->pos = pos;
+    if(proj == nullptr)
+        return;
+
+    proj->transform().pos = pos;
     proj->init_collision_pos(pos);
 }
 
 void host_projectile::on_cleanup(state& st)
 {
+    vec2f pos = transform().pos;
+
     auto proj = st.projectile_manage.make_new<explosion_projectile_host>();
 
-    proj->pos = pos;
+    if(proj == nullptr)
+        return;
+
+    proj->transform().pos = pos;
     proj->init_collision_pos(pos);
 }
@@ -3,166 +3,89 @@
 
 #include "networking.hpp"
 
-struct damageable_base : virtual network_serialisable
+///Ok. On any projectile collision, client or host, we need to spawn the explosion graphic
+///Only host wants to do collision detection
+struct projectile_base : base_class
 {
-    float hp = 1.f;
-    float max_hp = 1.f;
-
-    float pending_network_damage = 0.f;
-
-    virtual void damage(float amount)
-    {
-        pending_network_damage += amount;
-
-        hp -= amount;
-
-        hp = std::max(hp, 0.f);
-    }
-
-    float get_hp()
-    {
-        return hp;
-    }
-
-    void reset_hp()
-    {
-        hp = max_hp;
-    }
-
-    bool dead()
-    {
-        return hp <= 0.f;
-    }
-
-    virtual ~damageable_base()
-    {
-
-    }
+    int type = 0;
+    float rad = 2.f;
 
-    virtual byte_vector serialise_network() override
-    {
-        byte_vector vec;
-        vec.push_back<float>(pending_network_damage);
-        vec.push_back<int32_t>(0);
+    replication::position_encoder pos_encoder;
+    replication::position_decoder pos_decoder;
 
-        pending_network_damage = 0.f;
+    ///so a change in should_cleanup always goes out, even if we didn't move
+    bool last_sent_cleanup = false;
 
-        return vec;
-    }
+    virtual void tick(float dt_s, state& st) {}
 
-    virtual void deserialise_network(byte_fetch& fetch) override
+    projectile_base(int team)
     {
-        //float pending_damage = fetch.get<float>();
+        entities.transforms.add(entity);
 
-        float found_data = fetch.get<float>();
+        render_component& r = entities.renders.add(entity);
+        r.shape = render_shape::CIRCLE;
+        r.rad = rad;
 
-        int32_t type = fetch.get<int32_t>();
+        collision_component& c = entities.collisions.add(entity);
+        c.team = team;
+        c.type = collide::RAD;
+        c.group = collide::PROJECTILE;
+        c.collision_dim = {rad*2, rad*2};
 
-        if(type == 0)
-            hp -= found_data;
-        if(type == 1)
-            hp = found_data;
+        network_component& net = entities.networks.add(entity);
+        ///fast moving and short lived, stale projectiles are much more noticeable than stale particles
+        net.replication_priority = 4.f;
     }
-};
 
-struct damageable_client : virtual damageable_base, virtual networkable_client
-{
-    virtual void damage(float amount) override
+    projectile_base() : projectile_base(-1)
     {
-        damageable_base::damage(amount);
-
-        should_update = true;
+        collider().collision_dim = {2, 2};
     }
-};
-
-struct damageable_host : virtual damageable_base, virtual networkable_host
-{
-    damageable_host(network_state& ns) : networkable_host(ns) {}
 
-    virtual byte_vector serialise_network() override
+    void set_rad(float prad)
     {
-        byte_vector ret;
-        ret.push_back<float>(hp);
-        ret.push_back<int32_t>(1);
-
-        return ret;
-    }
-
-    /*virtual void deserialise_network(byte_fetch& fetch) override
-    {
-        ///received from a client
-        float pending_damage = fetch.get<float>();
-
-        damage(pending_damage);
-    }*/
-};
-
-
-///Ok. On any projectile collision, client or host, we need to spawn the explosion graphic
-///Only host wants to do collision detection
-struct projectile_base : virtual renderable, virtual collideable, virtual base_class, virtual network_serialisable
-{
-    vec2f pos;
-    int type = 0;
-    float rad = 2.f;
-
-    virtual void tick(float dt_s, state& st) {}
+        rad = prad;
 
-    projectile_base(int team) : collideable(team, collide::RAD)
-    {
-        collision_dim = {rad*2, rad*2};
+        render_info().rad = rad;
+        collider().collision_dim = {rad * 2.f, rad * 2.f};
     }
 
-    projectile_base() : collideable(-1, collide::RAD) {}
-
     virtual void set_owner(int id) override
     {
-        network_serialisable::set_owner(id);
+        base_class::set_owner(id);
 
-        team = id;
-    }
-
-    void render(sf::RenderWindow& win) override
-    {
-        sf::CircleShape shape;
-        shape.setRadius(rad);
-
-        shape.setOrigin(rad, rad);
-
-        shape.setPosition(pos.x(), pos.y());
-
-        win.draw(shape);
+        collider().team = id;
     }
 
+    ///position block first, see replication_shared.hpp
     virtual byte_vector serialise_network() override
     {
         byte_vector vec;
 
-        vec.push_back<vec2f>(pos);
-        vec.push_back<int32_t>(should_cleanup);
+        if(!pos_encoder.encode(transform().pos, should_cleanup != last_sent_cleanup, vec))
+            return vec;
 
-        return vec;
-    }
+        vec.push_back<uint8_t>(should_cleanup);
 
-    virtual void on_collide(state& st, collideable* other)
-    {
+        last_sent_cleanup = should_cleanup;
 
+        return vec;
     }
 
     virtual ~projectile_base() {}
 };
 
-struct explosion_projectile_base : virtual projectile_base, virtual networkable_none
+struct explosion_projectile_base : projectile_base
 {
-    std::map<collideable*, bool> hit;
     float alive_time = 0.f;
     float alive_time_max = 0.15f;
 
-    explosion_projectile_base() : collideable(-3, collide::RAD), projectile_base(-3)
+    explosion_projectile_base() : projectile_base(-3)
     {
-        rad = 10.f;
+        set_rad(10.f);
 
-        collision_dim = {rad * 2.f, rad * 2.f};
+        ///explosions are spawned locally on both ends, never networked
+        network().mode = net_mode::NONE;
     }
 
     virtual void tick(float dt_s, state& st) override
@@ -174,7 +97,7 @@ struct explosion_projectile_base : virtual projectile_base, virtual networkable_
             should_cleanup = true;
         }
 
-        set_collision_pos(pos);
+        set_collision_pos(transform().pos);
     }
 
     virtual byte_vector serialise_network() override
@@ -182,67 +105,47 @@ struct explosion_projectile_base : virtual projectile_base, virtual networkable_
         return byte_vector();
     }
 
-
-    virtual void on_cleanup(state& st) {}
-
-    virtual void process_recv(network_state& st)
-    {
-
-    }
-
     virtual ~explosion_projectile_base(){}
 };
 
-struct explosion_projectile_client : virtual explosion_projectile_base
+struct explosion_projectile_client : explosion_projectile_base
 {
-    explosion_projectile_client() : collideable(-3, collide::RAD), explosion_projectile_base() {}
-
     virtual ~explosion_projectile_client(){}
 };
 
-struct explosion_projectile_host : virtual explosion_projectile_base
+struct explosion_projectile_host : explosion_projectile_base
 {
-    explosion_projectile_host() : collideable(-3, collide::RAD), explosion_projectile_base() {}
-
-    virtual void on_collide(state& st, collideable* other)
-    {
-        if(hit[other])
-            return;
-
-        hit[other] = true;
-
-        if(dynamic_cast<damageable_base*>(other) != nullptr)
-        {
-            dynamic_cast<damageable_base*>(other)->damage(0.35);
-        }
-    }
-
     virtual ~explosion_projectile_host(){}
 };
 
-struct projectile : virtual projectile_base, virtual networkable_client
+struct projectile : projectile_base
 {
-    bool have_pos = false;
+    projectile(int team) : projectile_base(team)
+    {
+        network().mode = net_mode::CLIENT;
 
-    projectile(int team) : projectile_base(team), collideable(team, collide::RAD) {}
+        entities.interpolations.add(entity);
+    }
 
-    projectile() : collideable(-1, collide::RAD) {}
+    projectile() : projectile_base()
+    {
+        network().mode = net_mode::CLIENT;
 
-    virtual void deserialise_network(byte_fetch& fetch) override
+        entities.interpolations.add(entity);
+    }
+
+    virtual void deserialise_network(packet_view& fetch) override
     {
-        vec2f fpos = fetch.get<vec2f>();
-        should_cleanup = fetch.get<int32_t>();
+        vec2f fpos;
 
-        pos = fpos;
+        bool have_update = pos_decoder.decode(fetch, fpos);
 
-        if(!have_pos)
-        {
-            collideable::init_collision_pos(pos);
+        should_cleanup = fetch.get<uint8_t>();
 
-            have_pos = true;
-        }
+        if(!have_update)
+            return;
 
-        set_collision_pos(pos);
+        receive_position(fetch, fpos);
     }
 
     virtual void on_cleanup(state& st) override;
@@ -250,40 +153,38 @@ struct projectile : virtual projectile_base, virtual networkable_client
     virtual ~projectile(){}
 };
 
-struct host_projectile : virtual projectile_base, virtual networkable_host
+///moved by the movement system through its velocity component
+struct host_projectile : projectile_base
 {
-    vec2f dir;
-    float speed = 1.f;
-
-    host_projectile(int team, network_state& ns) : projectile_base(team), collideable(team, collide::RAD), networkable_host(ns) {}
-
-    virtual void on_collide(state& st, collideable* other) override
+    host_projectile(int team, network_state& ns) : projectile_base(team)
     {
-        projectile_base::on_collide(st, other);
+        network().mode = net_mode::HOST;
 
-        should_cleanup = true;
+        set_owner(ns.my_id);
 
-        if(dynamic_cast<damageable_base*>(other) != nullptr)
-        {
-            dynamic_cast<damageable_base*>(other)->damage(0.6);
-        }
-    }
+        velocity_component& v = entities.velocities.add(entity);
 
-    void tick(float dt_s, state& st) override
-    {
         #ifdef PROJECTILE_GRAVITY
-        dir += (vec2f){0, 1} * GRAVITY_STRENGTH * dt_s;
+        v.gravity = GRAVITY_STRENGTH;
         #endif
+    }
 
-        pos = pos + dir * dt_s * speed;
+    void set_velocity(vec2f dir, float speed)
+    {
+        entities.velocities.get(entity).vel = dir * speed;
+    }
 
-        set_collision_pos(pos);
+    virtual void on_collide(state& st, base_class* other) override
+    {
+        should_cleanup = true;
     }
 
-    virtual void deserialise_network(byte_fetch& fetch) override
+    virtual void deserialise_network(packet_view& fetch) override
     {
-        vec2f fpos = fetch.get<vec2f>();
-        should_cleanup = fetch.get<int32_t>();
+        vec2f fpos;
+
+        pos_decoder.decode(fetch, fpos);
+        should_cleanup = fetch.get<uint8_t>();
 
         //pos = fpos;
     }
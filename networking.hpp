@@ -2,246 +2,260 @@
 #define NETWORKING_HPP_INCLUDED
 
 #include "2d_quacku_servers/master_server/network_messages.hpp"
+#include "2d_quacku_servers/replication_shared.hpp"
+#include "2d_quacku_servers/wire_protocol_shared.hpp"
 
 #include "systems.hpp"
+#include "network_io.hpp"
+#include <unordered_map>
+#include <algorithm>
 
-inline
-udp_sock join_game(const std::string& address, const std::string& port)
+///so, network state should take other systems
+///each system has a network id
+///when receiving an object, we will have its system as part of its id
+///then each system does network_state.check(system), and relevant new objects are carted into the system
+///maintains nice separation
+struct network_state
 {
-    udp_sock sock = udp_connect(address, port);
-
-    byte_vector vec;
-    vec.push_back(canary_start);
-    vec.push_back(message::CLIENTJOINREQUEST);
-    vec.push_back(canary_end);
+    ///copied from io at the start of every tick, so it's stable for the whole tick
+    int my_id = -1;
 
-    udp_send(sock, vec.ptr);
+    ///the socket lives over there, on its own thread
+    network_io io;
 
-    return sock;
-}
+    bool connected()
+    {
+        return my_id != -1;
+    }
 
-///need to update this with what system we're using
-struct network_variable
-{
-    net_type::player_t player_id = -1;
-    int16_t object_id = -1;
-    int16_t system_network_id = -1;
+    ///inbound forwarding payloads, bucketed by who they're for as they're parsed
+    ///payloads are views into the datagram they arrived in, not copies of it
+    ///objects claim (and erase) their own bucket, whatever's left over is for objects we don't have yet
+    std::unordered_map<uint64_t, std::vector<packet_view>> inbound;
 
-    /*network_variable(int32_t in)
+    static uint64_t inbound_key(int16_t system_network_id, int16_t player_id, net_type::object_t object_id)
     {
-        *this = decompose(in);
-    }*/
+        return ((uint64_t)(uint16_t)system_network_id << 48) | ((uint64_t)(uint16_t)player_id << 32) | object_id;
+    }
 
-    network_variable(int16_t pid, int16_t oid, int16_t sid)
+    static network_variable inbound_variable(uint64_t key)
     {
-        player_id = pid;
-        object_id = oid;
-        system_network_id = sid;
+        return network_variable((int16_t)(uint16_t)((key >> 32) & 0xFFFF), (net_type::object_t)(key & 0xFFFFFFFF), (int16_t)(uint16_t)(key >> 48));
     }
 
-    network_variable(){}
-
-    /*network_variable decompose(int32_t in) const
+    ///joining (and retrying) is handled by the io thread
+    void leave_game()
     {
-        network_variable ret;
+        io.leave_requested = true;
 
-        ret.player_id = (in >> 16) & 0xFFFF;
-        ret.object_id = in & 0xFFFF;
+        my_id = -1;
+    }
 
-        return ret;
+    void send_datagram(std::vector<char>&& data)
+    {
+        if(!io.to_send.push(std::move(data)))
+            printf("network send queue full\n");
     }
 
-    int32_t compose()
+    ///everything the io thread has parsed since last tick
+    void tick()
     {
-        return (player_id << 16) | object_id;
-    }*/
-};
+        my_id = io.my_id;
 
-///so, network state should take other systems
-///each system has a network id
-///when receiving an object, we will have its system as part of its id
-///then each system does network_state.check(system), and relevant new objects are carted into the system
-///maintains nice separation
-struct network_state
-{
-    int my_id = -1;
-    int16_t next_object_id = 0;
-    udp_sock sock;
-    sockaddr_storage store;
-    bool have_sock = false;
+        inbound_message msg;
 
-    bool connected()
-    {
-        return (my_id != -1) && (sock.valid());
+        while(io.received.pop(msg))
+        {
+            handle_message(msg.type, msg.body);
+        }
     }
 
-    float timeout_max = 5.f;
-    float timeout = timeout_max;
+    void handle_message(uint32_t type, packet_view& fetch)
+    {
+        if(type == message::FORWARDING)
+        {
+            uint32_t data_size = fetch.get<uint32_t>();
 
-    std::vector<std::tuple<network_variable, byte_fetch, bool>> available_data;
+            network_variable nv = fetch.get<network_variable>();
 
-    void tick_join_game(float dt_s)
-    {
-        if(my_id != -1)
-            return;
+            if(data_size < sizeof(network_variable))
+            {
+                printf("forwarding too small\n");
 
-        timeout += dt_s;
+                data_size = sizeof(network_variable);
+            }
+
+            inbound[inbound_key(nv.system_network_id, nv.player_id, nv.object_id)].push_back(fetch.slice(data_size - sizeof(network_variable)));
+        }
 
-        if(timeout > timeout_max)
+        if(type == message::FORWARDING_BATCH)
         {
-            sock = join_game("127.0.0.1", GAMESERVER_PORT);
+            uint32_t data_size = fetch.get<uint32_t>();
+            uint16_t count = fetch.get<uint16_t>();
+            uint32_t sender_tick = fetch.get<uint32_t>();
+
+            packet_view entries = fetch.slice(data_size);
+            entries.sender_tick = sender_tick;
+
+            for(int i=0; i < count && !entries.finished(); i++)
+            {
+                network_variable nv = entries.get<network_variable>();
+                uint16_t len = entries.get<uint16_t>();
 
-            timeout = 0;
+                inbound[inbound_key(nv.system_network_id, nv.player_id, nv.object_id)].push_back(entries.slice(len));
+            }
         }
-    }
 
-    void leave_game()
-    {
-        sock.close();
+        if(type == message::TEAMASSIGNMENT)
+        {
+            int32_t assigned_id = fetch.get<int32_t>();
+            int32_t found_team = fetch.get<int32_t>();
+        }
 
-        my_id = -1;
+        if(type == message::PING_DATA)
+        {
+            int num = fetch.get<int32_t>();
+
+            for(int i=0; i<num && !fetch.finished(); i++)
+            {
+                int pid = fetch.get<int32_t>();
+                float ping = fetch.get<float>();
+            }
+        }
     }
 
-    void tick()
+    sf::Clock view_report_clk;
+    float view_report_interval_s = 0.25f;
+
+    ///lets the server cut down what it forwards us from off screen
+    void report_view(vec2f tl, vec2f br)
     {
-        if(!sock.valid())
+        if(!connected())
             return;
 
-        bool any_recv = true;
+        if(view_report_clk.getElapsedTime().asSeconds() < view_report_interval_s)
+            return;
 
-        while(any_recv && sock_readable(sock))
-        {
-            auto data = udp_receive_from(sock, &store);
+        view_report_clk.restart();
 
-            any_recv = data.size() > 0;
+        view_centre = (tl + br) / 2.f;
 
-            byte_fetch fetch;
-            fetch.ptr.swap(data);
+        byte_vector vec;
+        wire::start_datagram(vec);
+        size_t body = wire::begin(vec, message::VIEW_REPORT);
+        vec.push_back<vec2f>(tl);
+        vec.push_back<vec2f>(br);
+        wire::end(vec, body);
 
-            //this_frame_stats.bytes_in += data.size();
+        send_datagram(std::move(vec.ptr));
+    }
 
-            while(!fetch.finished() && any_recv)
-            {
-                int32_t found_canary = fetch.get<int32_t>();
+    ///replication scheduler: most important objects first, until this many bytes have gone out this tick
+    ///anything left over keeps accumulating priority until it makes the cut
+    int send_budget_bytes = 8192;
 
-                while(found_canary != canary_start && !fetch.finished())
-                {
-                    found_canary = fetch.get<int32_t>();
-                }
+    ///middle of the last view we reported, nearer objects go first
+    vec2f view_centre = {0,0};
 
-                int32_t type = fetch.get<int32_t>();
+    ///updates going out this tick, packed into as few datagrams as fit under FORWARDING_BATCH_MTU
+    ///header space is reserved up front and patched in on flush
+    ///the message length isn't known until flush either, it's slotted in between the type and the body then
+    byte_vector send_batch;
+    uint16_t send_batch_count = 0;
+    size_t send_batch_body = 0;
 
-                if(type == message::FORWARDING)
-                {
-                    uint32_t data_size = fetch.get<uint32_t>();
+    static constexpr int batch_header_size = sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint32_t);
 
-                    network_variable nv = fetch.get<network_variable>();
+    ///bumped once per sim tick by network_system, 0 is reserved for "no tick"
+    uint32_t send_tick = 0;
 
-                    available_data.push_back(std::make_tuple(nv, fetch, false));
+    ///state only goes out every this many ticks, remote ends interpolate the gaps
+    int send_interval_ticks = 3;
 
-                    for(int i=0; i < (data_size - sizeof(network_variable)) && i < 255; i++)
-                    {
-                        fetch.get<uint8_t>();
-                    }
+    float now_s()
+    {
+        return io.now_s();
+    }
+    static constexpr int batch_entry_header_size = sizeof(network_variable) + sizeof(uint16_t);
 
-                    auto found_end = fetch.get<decltype(canary_end)>();
+    void flush_sends()
+    {
+        if(send_batch_count == 0)
+            return;
 
-                    if(found_end != canary_end)
-                    {
-                        printf("forwarding ruh roh\n");
-                    }
-                }
+        std::vector<char>& data = send_batch.ptr;
 
-                if(type == message::CLIENTJOINACK)
-                {
-                    int32_t recv_id = fetch.get<int32_t>();
+        uint32_t data_size = data.size() - send_batch_body - batch_header_size;
 
-                    int32_t canary_found = fetch.get<int32_t>();
+        memcpy(&data[send_batch_body], &data_size, sizeof(data_size));
+        memcpy(&data[send_batch_body + sizeof(uint32_t)], &send_batch_count, sizeof(send_batch_count));
 
-                    if(canary_found == canary_end)
-                        my_id = recv_id;
-                    else
-                    {
-                        printf("err inclientjoinack\n");
-                    }
-                }
+        wire::end(send_batch, send_batch_body);
 
-                if(type == message::TEAMASSIGNMENT)
-                {
-                    int32_t assigned_id = fetch.get<int32_t>();
-                    int32_t found_team = fetch.get<int32_t>();
+        send_datagram(std::move(data));
 
-                    int32_t found_end = fetch.get<decltype(canary_end)>();
+        data.clear();
+        send_batch_count = 0;
 
-                    if(found_end != canary_end)
-                    {
-                        printf("err in teamassign\n");
-                    }
-                }
+        std::vector<char> recycled;
 
-                if(type == message::PING_DATA)
-                {
-                    int num = fetch.get<int32_t>();
+        if(io.spare.pop(recycled))
+            data.swap(recycled);
+    }
 
-                    for(int i=0; i<num; i++)
-                    {
-                        int pid = fetch.get<int32_t>();
-                        float ping = fetch.get<float>();
-                    }
+    ///queued, goes out on the next flush_sends
+    void forward_data(int player_id, net_type::object_t object_id, int system_network_id, const byte_vector& vec)
+    {
+        if(vec.ptr.size() > 0xFFFF)
+        {
+            printf("forward_data payload too big %i\n", (int)vec.ptr.size());
+            return;
+        }
 
-                    int32_t found_end = fetch.get<decltype(canary_end)>();
+        int entry_size = batch_entry_header_size + vec.ptr.size();
 
-                    if(found_end != canary_end)
-                    {
-                        printf("err in PING_DATA\n");
-                    }
-                }
+        ///oversized entries still get a datagram to themselves
+        if(send_batch_count > 0 && send_batch.ptr.size() + entry_size + wire::varint_size(send_batch.ptr.size() + entry_size) > FORWARDING_BATCH_MTU)
+            flush_sends();
 
-                if(type == message::PING)
-                {
-                    fetch.get<decltype(canary_end)>();
-                }
-            }
+        if(send_batch_count == 0)
+        {
+            wire::start_datagram(send_batch);
+            send_batch_body = wire::begin(send_batch, message::FORWARDING_BATCH);
+            send_batch.push_back<uint32_t>(0);
+            send_batch.push_back<uint16_t>(0);
+            send_batch.push_back<uint32_t>(send_tick);
         }
-    }
 
-    void forward_data(int player_id, int object_id, int system_network_id, const byte_vector& vec)
-    {
         network_variable nv(player_id, object_id, system_network_id);
 
-        uint32_t data_size = sizeof(nv) + vec.ptr.size();
+        send_batch.push_back<network_variable>(nv);
+        send_batch.push_back<uint16_t>(vec.ptr.size());
+        send_batch.push_vector(vec);
 
-        byte_vector cv;
-        cv.push_back(canary_start);
-        cv.push_back(message::FORWARDING);
-        cv.push_back(data_size);
-        cv.push_back<network_variable>(nv);
-        cv.push_vector(vec);
-        cv.push_back(canary_end);
-
-        udp_send_to(sock, cv.ptr, (const sockaddr*)&store);
-    }
-
-    int16_t get_next_object_id()
-    {
-        return next_object_id++;
+        send_batch_count++;
     }
 
+    ///run after network_system::tick, which normally leaves only messages nobody claimed
+    ///it doesn't run until we're connected though, so claimed objects can still be sitting here. Leave those for tick_cleanup
     template<typename manager_type, typename real_type>
     void check_create_network_entity(manager_type& generic_manager)
     {
-        for(auto& i : available_data)
+        for(auto it = inbound.begin(); it != inbound.end();)
         {
-            network_variable& var = std::get<0>(i);
-
-            if(var.system_network_id != generic_manager.system_network_id)
-                continue;
+            network_variable var = inbound_variable(it->first);
 
-            if(var.player_id == my_id)
+            if(var.system_network_id != generic_manager.system_network_id || var.player_id == my_id)
+            {
+                it++;
                 continue;
+            }
 
             if(generic_manager.owns(var.object_id, var.player_id))
+            {
+                it++;
                 continue;
+            }
 
             ///make new slave entity here!
 
@@ -249,146 +263,160 @@ struct network_state
             ///its because this is a dependent type
             auto new_entity = generic_manager.template make_new<real_type>();
 
-            real_type* found_entity = dynamic_cast<real_type*>(new_entity);
+            ///out of entity slots, drop it. We'll try again next time it's sent
+            if(new_entity == nullptr)
+            {
+                it = inbound.erase(it);
+                continue;
+            }
 
-            //real_type* found_entity = dynamic_cast<real_type*>(generic_manager.make_new<real_type>());
+            new_entity->set_owner(var.player_id);
 
-            found_entity->object_id = var.object_id;
-            found_entity->set_owner(var.player_id);
-            found_entity->ownership_class = var.player_id;
-        }
-    }
+            generic_manager.set_network_identity(new_entity, var.object_id, var.player_id);
 
-    void tick_cleanup()
-    {
-        for(int i=0; i<available_data.size(); i++)
-        {
-            if(std::get<2>(available_data[i]))
+            for(packet_view& view : it->second)
             {
-                available_data.erase(available_data.begin() + i);
-                i--;
-                continue;
+                new_entity->deserialise_network(view);
             }
+
+            it = inbound.erase(it);
         }
     }
-};
-
-struct network_serialisable : virtual base_class
-{
-    int owning_id = -1;
-
-    virtual byte_vector serialise_network() {return byte_vector();};
-    virtual void deserialise_network(byte_fetch& fetch) {};
 
-    //virtual void update(network_state& state) = 0;
-    virtual void process_recv(network_state& state) = 0;
-
-    virtual void set_owner(int id)
+    ///anything nobody claimed this frame is for a system we don't run, or ourselves
+    void tick_cleanup()
     {
-        owning_id = id;
+        inbound.clear();
     }
 };
 
-struct networkable_none : virtual network_serialisable
-{
-    virtual void process_recv(network_state& state) {}
-};
-
-struct networkable_host : virtual network_serialisable
+///hosts want to send their state every tick, clients only when should_update is set
+///what actually goes out each tick is decided by priority, up to network_state::send_budget_bytes
+///walks the network components directly rather than every object in every manager
+struct network_system
 {
-    networkable_host(network_state& ns)
+    ///O(1), the messages were already bucketed by who they're for
+    void process_recv(network_state& ns, base_class* obj, network_component& net)
     {
-        //object_id = ns.get_next_object_id();
-        set_owner(ns.my_id);
-    }
+        auto it = ns.inbound.find(network_state::inbound_key(net.system_network_id, net.owning_id, obj->object_id));
 
-    ///send serialisable properties across network
-    virtual void update(network_state& ns, int system_network_id)
-    {
-        if(!ns.connected())
+        if(it == ns.inbound.end())
             return;
 
-        set_owner(ns.my_id);
+        ///views are already bounded to their own payload, nothing else to check
+        for(packet_view& view : it->second)
+        {
+            obj->deserialise_network(view);
+        }
 
-        ns.forward_data(owning_id, object_id, system_network_id, serialise_network());
+        ns.inbound.erase(it);
     }
 
-    ///don't need system id here, only for creating new networkable clients
-    virtual void process_recv(network_state& ns)
+    ///per tick, added on to priority_accum
+    float tick_priority(network_state& ns, entity_t e, const network_component& net)
     {
-        if(!ns.connected())
-            return;
-
-        set_owner(ns.my_id);
+        float priority = net.replication_priority;
 
-        for(auto& i : ns.available_data)
+        ///something that hasn't moved is probably settled
+        if(entities.collisions.has(e))
         {
-            network_variable& var = std::get<0>(i);
+            const collision_component& c = entities.collisions.get(e);
 
-            if(var.player_id == owning_id && var.object_id == object_id)
-            {
-                deserialise_network(std::get<1>(i));
+            if(c.collision_pos == c.last_collision_pos)
+                priority *= 0.25f;
+        }
 
-                byte_fetch& fetch = std::get<1>(i);
+        if(entities.transforms.has(e))
+        {
+            float dist = (entities.transforms.get(e).pos - ns.view_centre).length();
 
-                int canary = fetch.get<decltype(canary_end)>();
+            priority *= 1.f / (1.f + dist / 1000.f);
+        }
 
-                if(canary != canary_end)
-                {
-                    printf("error host process recv\n");
-                }
+        ///damage etc, someone's waiting on this
+        if(net.mode == net_mode::CLIENT)
+            priority += 10.f;
 
-                std::get<2>(i) = true;
-            }
-        }
+        return priority;
     }
-};
 
-///we need to discover new objects as they're sent to us
-struct networkable_client : virtual network_serialisable
-{
-    bool should_update = false;
+    std::vector<std::pair<float, entity_t>> candidates;
 
-    ///if we have properties we need to network, but not movement
-    ///eg we don't own this
-    virtual void update(network_state& ns, int system_network_id)
+    void tick(network_state& ns)
     {
-        if(!ns.connected())
-            return;
+        ns.send_tick++;
 
-        if(!should_update)
+        if(!ns.connected())
             return;
 
-        ns.forward_data(owning_id, object_id, system_network_id, serialise_network());
+        component_array<network_component>& networks = entities.networks;
 
-        should_update = false;
-    }
+        bool send_this_tick = (ns.send_tick % ns.send_interval_ticks) == 0;
 
-    virtual void process_recv(network_state& ns)
-    {
-        if(!ns.connected())
-            return;
+        candidates.clear();
 
-        for(auto& i : ns.available_data)
+        for(int i=0; i<networks.size(); i++)
         {
-            network_variable& var = std::get<0>(i);
+            entity_t e = networks.owners[i];
+            base_class* obj = entities.get_object(e);
 
-            if(var.player_id == owning_id && var.object_id == object_id)
-            {
-                deserialise_network(std::get<1>(i));
+            if(networks.dense[i].mode == net_mode::NONE)
+                continue;
 
-                byte_fetch& fetch = std::get<1>(i);
+            ///send serialisable properties across network
+            if(networks.dense[i].mode == net_mode::HOST)
+            {
+                if(networks.dense[i].owning_id != ns.my_id)
+                    obj->set_owner(ns.my_id);
+            }
 
-                int canary = fetch.get<decltype(canary_end)>();
+            network_component& net = networks.dense[i];
 
-                if(canary != canary_end)
-                {
-                    printf("error host process recv");
-                }
+            ///hosts always want to go, clients only if we have properties we need to network, but not movement
+            ///eg we don't own this
+            if(send_this_tick && (net.mode == net_mode::HOST || (net.mode == net_mode::CLIENT && net.should_update)))
+            {
+                net.priority_accum += tick_priority(ns, e, net);
 
-                std::get<2>(i) = true;
+                candidates.push_back({net.priority_accum, e});
             }
+
+            process_recv(ns, obj, net);
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [](const std::pair<float, entity_t>& p1, const std::pair<float, entity_t>& p2)
+        {
+            return p1.first > p2.first;
+        });
+
+        int sent_bytes = 0;
+
+        for(auto& candidate : candidates)
+        {
+            ///the one that crosses the line still goes, so we never serialise something and then not send it
+            if(sent_bytes >= ns.send_budget_bytes)
+                break;
+
+            entity_t e = candidate.second;
+
+            base_class* obj = entities.get_object(e);
+            network_component& net = entities.networks.get(e);
+
+            byte_vector vec = obj->serialise_network();
+
+            net.priority_accum = 0.f;
+            net.should_update = false;
+
+            ///nothing changed since the last send
+            if(vec.ptr.size() == 0)
+                continue;
+
+            ns.forward_data(net.owning_id, obj->object_id, net.system_network_id, vec);
+
+            sent_bytes += network_state::batch_entry_header_size + vec.ptr.size();
         }
+
+        ns.flush_sends();
     }
 };
 
@@ -0,0 +1,96 @@
+#ifndef PACKET_VIEW_HPP_INCLUDED
+#define PACKET_VIEW_HPP_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include <algorithm>
+#include <vector>
+
+///a read window into a received datagram
+///every message parsed out of a datagram shares the one buffer, so nothing gets copied per message
+///reads like byte_fetch, but never reads past its own window
+struct packet_view
+{
+    std::shared_ptr<const std::vector<char>> buf;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+
+    ///relative to offset
+    uint32_t counter = 0;
+
+    ///stamped on at parse time, carried through slices
+    ///the tick the sender's batch went out on, 0 if it didn't say
+    uint32_t sender_tick = 0;
+    ///network_state::now_s() when it arrived
+    float received_s = 0.f;
+
+    packet_view(){}
+
+    packet_view(std::shared_ptr<const std::vector<char>> pbuf) : buf(std::move(pbuf))
+    {
+        length = buf->size();
+    }
+
+    ///for pooled buffers that are bigger than what was actually received
+    packet_view(std::shared_ptr<const std::vector<char>> pbuf, uint32_t plength) : buf(std::move(pbuf))
+    {
+        length = std::min(plength, (uint32_t)buf->size());
+    }
+
+    template<typename T>
+    T get()
+    {
+        T ret = T();
+
+        if(counter + sizeof(T) > length)
+        {
+            printf("packet_view read past end\n");
+
+            counter = length;
+
+            return ret;
+        }
+
+        memcpy(&ret, buf->data() + offset + counter, sizeof(T));
+
+        counter += sizeof(T);
+
+        return ret;
+    }
+
+    ///the next len bytes as their own view, and skip over them
+    packet_view slice(uint32_t len)
+    {
+        len = std::min(len, length - counter);
+
+        packet_view ret;
+        ret.buf = buf;
+        ret.sender_tick = sender_tick;
+        ret.received_s = received_s;
+        ret.offset = offset + counter;
+        ret.length = len;
+
+        counter += len;
+
+        return ret;
+    }
+
+    const char* data() const
+    {
+        return buf->data() + offset;
+    }
+
+    uint32_t remaining() const
+    {
+        return length - counter;
+    }
+
+    bool finished() const
+    {
+        return counter >= length;
+    }
+};
+
+#endif // PACKET_VIEW_HPP_INCLUDED
@@ -0,0 +1,52 @@
+#ifndef PROFILER_PANEL_HPP_INCLUDED
+#define PROFILER_PANEL_HPP_INCLUDED
+
+#include <imgui/imgui.h>
+#include "2d_quacku_servers/profiler_shared.hpp"
+
+///rolling per phase timings from the profiler ring buffers
+///only reads what's new each frame, see profiler::recent_reader
+struct profiler_panel
+{
+    profiler::recent_reader reader;
+
+    void render()
+    {
+        ImGui::Begin("Profiler");
+
+        reader.poll();
+
+        for(const profiler::phase_history& phase : reader.phases)
+        {
+            const std::vector<float>& durations = phase.durations;
+
+            if(durations.size() == 0)
+                continue;
+
+            float total = 0.f;
+            float max_ms = 0.f;
+
+            for(float f : durations)
+            {
+                total += f;
+                max_ms = std::max(max_ms, f);
+            }
+
+            float avg_ms = total / durations.size();
+
+            ImGui::Text("%s avg %.3fms max %.3fms", phase.label.c_str(), avg_ms, max_ms);
+
+            ///values_offset starts the plot at the oldest sample in the ring
+            ImGui::PlotHistogram(phase.plot_id.c_str(), &durations[0], durations.size(), phase.next, nullptr, 0.f, max_ms, ImVec2(0, 40));
+        }
+
+        if(ImGui::Button("Dump Trace"))
+        {
+            profiler::dump_chrome_trace("client_trace.json");
+        }
+
+        ImGui::End();
+    }
+};
+
+#endif // PROFILER_PANEL_HPP_INCLUDED
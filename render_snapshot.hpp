@@ -0,0 +1,79 @@
+#ifndef RENDER_SNAPSHOT_HPP_INCLUDED
+#define RENDER_SNAPSHOT_HPP_INCLUDED
+
+#include <atomic>
+#include <vector>
+
+#include "entity_store.hpp"
+
+///everything the renderer needs to draw one entity, copied out by the sim thread
+///carries the previous tick's transform too, so the render thread can interpolate without the entity store
+struct render_snapshot_entry
+{
+    entity_t e = invalid_entity;
+    render_component r;
+
+    vec2f pos = {0,0};
+    vec2f last_pos = {0,0};
+
+    float rotation = 0.f;
+    float last_rotation = 0.f;
+};
+
+struct render_snapshot
+{
+    std::vector<render_snapshot_entry> entries;
+
+    uint32_t sim_tick = 0;
+};
+
+///one writer, one reader, neither ever waits on the other
+///the writer fills its back buffer and publishes it by swapping it into the middle
+///the reader swaps the middle into its front buffer whenever something new has been published
+template<typename T>
+struct triple_buffer
+{
+    T buffers[3];
+
+    ///low two bits are the buffer index, fresh_bit set means the reader hasn't seen it yet
+    static constexpr int fresh_bit = 4;
+
+    std::atomic_int middle{1};
+
+    ///only ever touched by the writer
+    int back = 0;
+    ///only ever touched by the reader
+    int front = 2;
+
+    T& write_buffer()
+    {
+        return buffers[back];
+    }
+
+    void publish()
+    {
+        int old = middle.exchange(back | fresh_bit);
+
+        back = old & 3;
+    }
+
+    ///true if front now holds something newer than it did
+    bool acquire()
+    {
+        if((middle.load() & fresh_bit) == 0)
+            return false;
+
+        int old = middle.exchange(front);
+
+        front = old & 3;
+
+        return true;
+    }
+
+    const T& read_buffer() const
+    {
+        return buffers[front];
+    }
+};
+
+#endif // RENDER_SNAPSHOT_HPP_INCLUDED
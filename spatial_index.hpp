@@ -0,0 +1,164 @@
+#ifndef SPATIAL_INDEX_HPP_INCLUDED
+#define SPATIAL_INDEX_HPP_INCLUDED
+
+#include <stdint.h>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+#include <vec/vec.hpp>
+
+inline
+uint64_t grid_cell_key(int32_t cx, int32_t cy)
+{
+    return ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy;
+}
+
+inline
+int32_t grid_cell(float v, float cell_size)
+{
+    return (int32_t)floorf(v / cell_size);
+}
+
+///calls func on every occupied cell overlapping [tl - pad, br + pad]
+///anything keyed by grid_cell_key works, so baked geometry can be chunked the same way
+template<typename T, typename func>
+void visit_cells(const std::unordered_map<uint64_t, T>& cells, float cell_size, float pad, vec2f tl, vec2f br, func f)
+{
+    int32_t min_x = grid_cell(tl.x() - pad, cell_size);
+    int32_t min_y = grid_cell(tl.y() - pad, cell_size);
+    int32_t max_x = grid_cell(br.x() + pad, cell_size);
+    int32_t max_y = grid_cell(br.y() + pad, cell_size);
+
+    int64_t num_in_rect = ((int64_t)max_x - min_x + 1) * ((int64_t)max_y - min_y + 1);
+
+    ///zoomed right out, cheaper to walk the occupied cells than the rectangle
+    if(num_in_rect > (int64_t)cells.size())
+    {
+        for(auto& i : cells)
+        {
+            int32_t cx = (int32_t)(uint32_t)(i.first >> 32);
+            int32_t cy = (int32_t)(uint32_t)(i.first & 0xFFFFFFFF);
+
+            if(cx < min_x || cx > max_x || cy < min_y || cy > max_y)
+                continue;
+
+            f(i.second);
+        }
+
+        return;
+    }
+
+    for(int32_t y = min_y; y <= max_y; y++)
+    {
+        for(int32_t x = min_x; x <= max_x; x++)
+        {
+            auto it = cells.find(grid_cell_key(x, y));
+
+            if(it == cells.end())
+                continue;
+
+            f(it->second);
+        }
+    }
+}
+
+///uniform grid over entity positions, so the renderer only walks what's near the camera
+///an entity lives in the cell its centre is in, queries get padded by the biggest extent we've seen
+///so something overhanging a cell edge still gets picked up
+template<typename key_type>
+struct spatial_index
+{
+    float cell_size = 256.f;
+    float max_extent = 0.f;
+
+    std::unordered_map<uint64_t, std::vector<key_type>> cells;
+
+    struct entry
+    {
+        bool placed = false;
+        uint64_t cell = 0;
+        int32_t idx = -1;
+    };
+
+    ///indexed by whatever slot the caller hands us, not the full key
+    std::vector<entry> entries;
+
+    void insert(uint32_t slot, key_type k, uint64_t cell)
+    {
+        std::vector<key_type>& bucket = cells[cell];
+
+        entry& en = entries[slot];
+        en.placed = true;
+        en.cell = cell;
+        en.idx = bucket.size();
+
+        bucket.push_back(k);
+    }
+
+    ///slot_of maps a stored key back to its slot, so we can fix up whoever got swapped into the hole
+    template<typename func>
+    void remove(uint32_t slot, func slot_of)
+    {
+        if(slot >= entries.size() || !entries[slot].placed)
+            return;
+
+        entry& en = entries[slot];
+
+        auto it = cells.find(en.cell);
+
+        if(it != cells.end())
+        {
+            std::vector<key_type>& bucket = it->second;
+
+            int32_t last = (int32_t)bucket.size() - 1;
+
+            if(en.idx != last)
+            {
+                bucket[en.idx] = bucket[last];
+
+                entries[slot_of(bucket[en.idx])].idx = en.idx;
+            }
+
+            bucket.pop_back();
+
+            if(bucket.size() == 0)
+                cells.erase(it);
+        }
+
+        en.placed = false;
+        en.idx = -1;
+    }
+
+    ///cheap when nothing crossed a cell boundary, which is nearly every call
+    template<typename func>
+    void update(uint32_t slot, key_type k, vec2f pos, float extent, func slot_of)
+    {
+        max_extent = std::max(max_extent, extent);
+
+        if(slot >= entries.size())
+            entries.resize(slot + 1);
+
+        uint64_t cell = grid_cell_key(grid_cell(pos.x(), cell_size), grid_cell(pos.y(), cell_size));
+
+        if(entries[slot].placed && entries[slot].cell == cell)
+            return;
+
+        remove(slot, slot_of);
+        insert(slot, k, cell);
+    }
+
+    ///everything whose cell overlaps [tl, br], padded by max_extent
+    ///callers still want to do an exact test, this is cell granularity
+    void query(vec2f tl, vec2f br, std::vector<key_type>& out) const
+    {
+        out.clear();
+
+        visit_cells(cells, cell_size, max_extent, tl, br, [&](const std::vector<key_type>& bucket)
+        {
+            out.insert(out.end(), bucket.begin(), bucket.end());
+        });
+    }
+};
+
+#endif // SPATIAL_INDEX_HPP_INCLUDED
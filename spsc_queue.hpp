@@ -0,0 +1,61 @@
+#ifndef SPSC_QUEUE_HPP_INCLUDED
+#define SPSC_QUEUE_HPP_INCLUDED
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+
+///one producer thread, one consumer thread, fixed capacity, no locks
+///push fails rather than waits when it's full, it's up to the producer what to drop
+///values are moved in and out, so a popped slot doesn't keep anything alive
+template<typename T>
+struct spsc_queue
+{
+    std::vector<T> slots;
+
+    ///next slot to pop, only the consumer writes it
+    alignas(64) std::atomic<uint32_t> head{0};
+    ///next slot to push, only the producer writes it
+    alignas(64) std::atomic<uint32_t> tail{0};
+
+    ///one slot is always left empty to tell full from empty
+    spsc_queue(uint32_t capacity) : slots(capacity + 1) {}
+
+    uint32_t next(uint32_t idx) const
+    {
+        idx++;
+
+        return idx == slots.size() ? 0 : idx;
+    }
+
+    bool push(T&& val)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t n = next(t);
+
+        if(n == head.load(std::memory_order_acquire))
+            return false;
+
+        slots[t] = std::move(val);
+
+        tail.store(n, std::memory_order_release);
+
+        return true;
+    }
+
+    bool pop(T& out)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+
+        if(h == tail.load(std::memory_order_acquire))
+            return false;
+
+        out = std::move(slots[h]);
+
+        head.store(next(h), std::memory_order_release);
+
+        return true;
+    }
+};
+
+#endif // SPSC_QUEUE_HPP_INCLUDED
@@ -4,191 +4,486 @@
 #include <SFML/Graphics.hpp>
 #include <vec/vec.hpp>
 #include <imgui/imgui.h>
+#include <net/shared.hpp>
+#include <map>
+
+#include "entity_store.hpp"
+#include "render_snapshot.hpp"
+#include "packet_view.hpp"
 
 #define GRAVITY_STRENGTH 1600.f
 #define FORCE_MULTIPLIER 1.f
 
 struct state;
 
+///the only polymorphic base left. Data lives in components in the entity store
+///behaviour that genuinely differs per type stays virtual here
 struct base_class
 {
     bool should_cleanup = false;
-    int16_t object_id = -1;
+    ///our own entity for local objects, the owner's entity handle for replicas
+    uint32_t object_id = invalid_entity;
     int16_t ownership_class = -1;
 
+    entity_t entity;
+
+    base_class()
+    {
+        entity = entities.create(this);
+
+        object_id = entity;
+    }
+
+    base_class(const base_class&) = delete;
+    base_class& operator=(const base_class&) = delete;
+
+    virtual ~base_class()
+    {
+        entities.destroy(entity);
+    }
+
     virtual void on_cleanup(state& st) {}
-};
 
-struct renderable
-{
-    sf::Image img;
-    sf::Texture tex;
-    vec3f col = {1, 1, 1};
+    virtual void on_collide(state& st, base_class* other) {}
+
+    ///only called for non RAD colliders, RAD vs RAD is handled by the collision system
+    virtual bool intersects(const collision_component& other) {return false;}
 
-    bool should_render = true;
+    virtual byte_vector serialise_network() {return byte_vector();}
+    virtual void deserialise_network(packet_view& fetch) {}
 
-    renderable()
+    virtual void set_owner(int id)
     {
-        img.create(20, 20, sf::Color(255, 255, 255));
-        tex.loadFromImage(img);
+        if(entities.networks.has(entity))
+            entities.networks.get(entity).owning_id = id;
+    }
 
-        generate_colour();
+    transform_component& transform()
+    {
+        return entities.transforms.get(entity);
     }
 
-    virtual void render(sf::RenderWindow& win, vec2f pos, float rotation)
+    render_component& render_info()
     {
-        if(!should_render)
-            return;
+        return entities.renders.get(entity);
+    }
 
-        sf::Sprite spr(tex);
-        spr.setOrigin(tex.getSize().x/2, tex.getSize().y/2);
-        spr.setPosition(pos.x(), pos.y());
-        spr.setColor(sf::Color(255 * col.x(), 255 * col.y(), 255 * col.z()));
-        spr.setRotation(r2d(rotation));
+    collision_component& collider()
+    {
+        return entities.collisions.get(entity);
+    }
 
-        win.draw(spr);
+    network_component& network()
+    {
+        return entities.networks.get(entity);
     }
 
-    void generate_colour()
+    void set_collision_pos(vec2f pos)
     {
-        float ffrac = 0.7f;
+        collision_component& c = collider();
 
-        col = randf<3, float>() * ffrac + (1.f - ffrac);
-    }
+        c.last_collision_pos = c.collision_pos;
+        c.collision_pos = pos;
 
-    virtual void render(sf::RenderWindow& win) = 0;
+        entities.moved(entity);
+    }
 
-    virtual ~renderable()
+    void init_collision_pos(vec2f pos)
     {
+        collision_component& c = collider();
 
+        c.last_collision_pos = pos;
+        c.collision_pos = pos;
+
+        entities.moved(entity);
     }
 
-    bool out_of_bounds(sf::RenderWindow& win, vec2f pos, float rad)
+    ///for remote objects with a jitter buffer, the interpolation system moves them from here on
+    ///the first position is snapped to so they don't slide in from the origin
+    void receive_position(const packet_view& fetch, vec2f pos)
     {
-        auto sf_spos = win.mapCoordsToPixel({pos.x(), pos.y()});
+        jitter_buffer& buf = entities.interpolations.get(entity);
 
-        vec2f spos = {sf_spos.x, sf_spos.y};
+        if(!buf.have_offset)
+        {
+            transform().pos = pos;
+            init_collision_pos(pos);
+        }
 
-        float hx = rad*2;
-        float hy = rad*2;
+        ///nothing to place it in time with, just go there
+        if(fetch.sender_tick == 0)
+        {
+            transform().pos = pos;
+            set_collision_pos(pos);
 
-        if(spos.x() + hx < 0 || spos.y() + hy < 0 || spos.x() - hx > win.getSize().x || spos.y() - hy > win.getSize().y)
-            return true;
+            return;
+        }
 
-        return false;
+        buf.push(fetch.sender_tick, pos, fetch.received_s);
     }
 };
 
-namespace collide
+inline
+vec3f generate_colour()
 {
-    enum type
-    {
-        NONE,
-        RAD,
-        PHYS_LINE,
-    };
-}
+    float ffrac = 0.7f;
 
-using collide_t = collide::type;
+    return randf<3, float>() * ffrac + (1.f - ffrac);
+}
 
-struct collideable : virtual base_class
+///integrates anything with a velocity, and keeps its collider in sync
+struct movement_system
 {
-    int team = 0;
+    void tick(float dt_s)
+    {
+        component_array<velocity_component>& velocities = entities.velocities;
 
-    bool fully_init = false;
-    uint32_t collision_state = 0;
-    vec2f last_collision_pos;
-    vec2f collision_pos;
-    vec2f collision_dim = {2, 2};
+        for(int i=0; i<velocities.size(); i++)
+        {
+            velocity_component& v = velocities.dense[i];
+            entity_t e = velocities.owners[i];
+
+            v.vel += (vec2f){0, 1} * v.gravity * dt_s;
+
+            transform_component& t = entities.transforms.get(e);
+
+            t.pos = t.pos + v.vel * dt_s;
+
+            if(entities.collisions.has(e))
+            {
+                collision_component& c = entities.collisions.get(e);
+
+                c.last_collision_pos = c.collision_pos;
+                c.collision_pos = t.pos;
+            }
+
+            entities.moved(e);
+        }
+    }
+};
 
-    collide_t type;
+struct collision_system
+{
+    std::vector<entity_t> group_a;
+    std::vector<entity_t> group_b;
 
-    collideable(int t, collide_t _type)
+    bool intersects(collision_component& c1, collision_component& c2, entity_t e2)
     {
-        team = t;
-        type = _type;
+        if(c1.type == collide::RAD && c2.type == collide::RAD)
+        {
+            vec2f diff = c1.collision_pos - c2.collision_pos;
+
+            if(diff.length() < c1.collision_dim.length()/2.f || diff.length() < c2.collision_dim.length()/2.f)
+                return true;
+
+            return false;
+        }
+
+        if(c1.type == collide::RAD && c2.type == collide::PHYS_LINE)
+            return entities.get_object(e2)->intersects(c1);
+
+        printf("unsupported collider type %i\n", c1.type);
+
+        return false;
     }
 
-    virtual bool can_collide() {return true;}
+    void gather(collide_group_t group, std::vector<entity_t>& out)
+    {
+        out.clear();
+
+        component_array<collision_component>& collisions = entities.collisions;
 
-    virtual void on_collide(state& st, collideable* other) {}
+        for(int i=0; i<collisions.size(); i++)
+        {
+            if(collisions.dense[i].group == group)
+                out.push_back(collisions.owners[i]);
+        }
+    }
 
-    virtual bool intersects(collideable* other)
+    ///on_collide may add or remove components, so never hold a component reference across it
+    void check_collisions(state& st, collide_group_t my_group, collide_group_t their_group)
     {
-        //if (RectA.Left < RectB.Right && RectA.Right > RectB.Left &&
-        //RectA.Top > RectB.Bottom && RectA.Bottom < RectB.Top )
+        gather(my_group, group_a);
+        gather(their_group, group_b);
 
-        /*vec2f mhdim = collision_dim/2.f;
-        vec2f thdim = other->collision_dim/2.f;
+        for(entity_t my_e : group_a)
+        {
+            for(entity_t their_e : group_b)
+            {
+                if(my_e == their_e)
+                    continue;
 
-        vec2f Atl = collision_pos - mhdim;
-        vec2f Abr = collision_pos + mhdim;
+                if(!entities.collisions.has(my_e) || !entities.collisions.has(their_e))
+                    continue;
 
-        vec2f Btl = other->collision_pos - thdim;
-        vec2f Bbr = other->collision_pos + thdim;
+                collision_component& mine = entities.collisions.get(my_e);
+                collision_component& theirs = entities.collisions.get(their_e);
 
-        std::cout << collision_pos << " " << other->collision_pos << std::endl;
-        std::cout << Atl << " " << Abr << " " << Btl << " " << Bbr << std::endl;
+                if(!mine.enabled || !theirs.enabled)
+                    continue;
 
-        if(Atl.x() < Bbr.x() && Abr.x() > Btl.x() && Atl.y() > Bbr.y() && Abr.y() < Btl.y())
-        {
-            std::cout << "hello\n";
+                if(intersects(mine, theirs, their_e))
+                {
+                    base_class* my_t = entities.get_object(my_e);
+                    base_class* their_t = entities.get_object(their_e);
 
-            return true;
+                    my_t->on_collide(st, their_t);
+                    their_t->on_collide(st, my_t);
+                }
+            }
         }
+    }
+};
 
-        return false;*/
+///plays remote objects back out of their jitter buffers, a little behind real time
+struct interpolation_system
+{
+    void tick(float now_s)
+    {
+        component_array<jitter_buffer>& interpolations = entities.interpolations;
 
-        if(type == collide::RAD && other->type == collide::RAD)
+        for(int i=0; i<interpolations.size(); i++)
         {
-            vec2f diff = collision_pos - other->collision_pos;
+            vec2f pos;
 
-            if(diff.length() < collision_dim.length()/2.f || diff.length() < other->collision_dim.length()/2.f)
-                return true;
+            if(!interpolations.dense[i].sample_at(now_s, pos))
+                continue;
 
-            return false;
+            entity_t e = interpolations.owners[i];
+
+            entities.transforms.get(e).pos = pos;
+
+            if(entities.collisions.has(e))
+                entities.get_object(e)->set_collision_pos(pos);
+            else
+                entities.moved(e);
         }
+    }
+};
+
+///runs on the sim thread, copies out what's near the camera for the render thread
+struct snapshot_system
+{
+    struct last_state
+    {
+        entity_t e = invalid_entity;
+        uint32_t sim_tick = 0;
+        vec2f pos = {0,0};
+        float rotation = 0.f;
+    };
+
+    ///by entity slot, what we published for it last time
+    std::vector<last_state> last;
+    std::vector<entity_t> nearby;
+
+    void build(render_snapshot& out, uint32_t sim_tick, vec2f tl, vec2f br)
+    {
+        out.entries.clear();
+        out.sim_tick = sim_tick;
 
-        if(type == collide::RAD && other->type == collide::PHYS_LINE)
-            return other->intersects(this);
+        entities.visible.query(tl, br, nearby);
 
-        /*if(type == collide::PHYS_LINE && other->type == collide::RAD)
+        for(entity_t e : nearby)
         {
-            return
-        }*/
+            const render_component& r = entities.renders.get(e);
 
-        printf("unsupported collider type %i\n", type);
+            if(!r.should_render)
+                continue;
 
-        return false;
+            const transform_component& t = entities.transforms.get(e);
+
+            uint32_t slot = entity_index(e);
+
+            if(slot >= last.size())
+                last.resize(slot + 1);
+
+            last_state& prev = last[slot];
+
+            ///wasn't in the previous snapshot, nothing sensible to interpolate from
+            if(prev.e != e || prev.sim_tick + 1 != sim_tick)
+            {
+                prev.pos = t.pos;
+                prev.rotation = t.rotation;
+            }
+
+            render_snapshot_entry entry;
+            entry.e = e;
+            entry.r = r;
+            entry.pos = t.pos;
+            entry.last_pos = prev.pos;
+            entry.rotation = t.rotation;
+            entry.last_rotation = prev.rotation;
+
+            out.entries.push_back(entry);
+
+            prev.e = e;
+            prev.sim_tick = sim_tick;
+            prev.pos = t.pos;
+            prev.rotation = t.rotation;
+        }
     }
+};
 
-    void set_collision_pos(vec2f pos)
+struct texture_cache
+{
+    ///std::map so references stay valid as textures get added
+    std::map<uint64_t, sf::Texture> textures;
+
+    const sf::Texture& get(const texture_key& key)
     {
-        last_collision_pos = collision_pos;
-        collision_pos = pos;
+        auto it = textures.find(key.hash());
+
+        if(it != textures.end())
+            return it->second;
+
+        sf::Texture& tex = textures[key.hash()];
+
+        sf::Image img;
+        img.create(key.width, key.height, sf::Color(255, 255, 255));
+
+        tex.loadFromImage(img);
+
+        return tex;
     }
+};
 
-    void init_collision_pos(vec2f pos)
+struct render_system
+{
+    texture_cache textures;
+
+    ///this frame's camera rect in world space
+    vec2f view_tl;
+    vec2f view_br;
+
+    bool out_of_bounds(vec2f pos, float extent)
     {
-        last_collision_pos = pos;
-        collision_pos = pos;
+        return pos.x() + extent < view_tl.x() || pos.y() + extent < view_tl.y() ||
+               pos.x() - extent > view_br.x() || pos.y() - extent > view_br.y();
     }
 
-    virtual ~collideable()
+    void render_sprite(sf::RenderWindow& win, const render_component& r, const transform_component& t)
     {
+        if(r.tex.shape == texture_shape::NONE)
+            return;
 
+        const sf::Texture& tex = textures.get(r.tex);
+
+        sf::Sprite spr(tex);
+        spr.setOrigin(tex.getSize().x/2, tex.getSize().y/2);
+        spr.setPosition(t.pos.x(), t.pos.y());
+        spr.setColor(sf::Color(255 * r.col.x(), 255 * r.col.y(), 255 * r.col.z()));
+        spr.setRotation(r2d(t.rotation));
+
+        win.draw(spr);
     }
-};
 
-struct moveable : virtual base_class
-{
-    vec2f pos;
-    float rotation = 0.f;
+    void render_circle(sf::RenderWindow& win, const render_component& r, const transform_component& t)
+    {
+        sf::CircleShape shape;
+        shape.setRadius(r.rad);
+
+        shape.setOrigin(r.rad, r.rad);
+
+        shape.setPosition(t.pos.x(), t.pos.y());
 
-    bool has_default = false;
-    bool on_default_side = false;
-    float side_time = 0.f;
-    float side_time_max = 0.100f;
+        win.draw(shape);
+    }
+
+    ///every particle on screen goes into one triangle list, drawn once at the end of render
+    ///order within the array is preserved, so outline -> fill -> bonds still layers correctly
+    sf::VertexArray particle_batch{sf::Triangles};
+
+    ///segments per disc, the outline ring uses the same count
+    static constexpr int particle_segments = 16;
+
+    void push_tri(vec2f p1, vec2f p2, vec2f p3, sf::Color col)
+    {
+        particle_batch.append(sf::Vertex({p1.x(), p1.y()}, col));
+        particle_batch.append(sf::Vertex({p2.x(), p2.y()}, col));
+        particle_batch.append(sf::Vertex({p3.x(), p3.y()}, col));
+    }
+
+    void push_quad(vec2f p1, vec2f p2, vec2f p3, vec2f p4, sf::Color col)
+    {
+        push_tri(p1, p2, p3, col);
+        push_tri(p1, p3, p4, col);
+    }
+
+    void render_particle(sf::RenderWindow& win, const render_component& r, const transform_component& t)
+    {
+        vec3f fcol = r.col * 255.f;
+
+        sf::Color fill(fcol.x(), fcol.y(), fcol.z());
+        sf::Color outline(fcol.x()/2.f, fcol.y()/2.f, fcol.z()/2.f);
+
+        ///matches the old sf::CircleShape outline, which sat outside the radius
+        float outline_thickness = 2.f;
+        float outer_rad = r.rad + outline_thickness;
+
+        for(int i=0; i<particle_segments; i++)
+        {
+            float a1 = ((float)i / particle_segments) * 2 * M_PI;
+            float a2 = ((float)(i + 1) / particle_segments) * 2 * M_PI;
+
+            vec2f d1 = {cos(a1), sin(a1)};
+            vec2f d2 = {cos(a2), sin(a2)};
+
+            push_quad(t.pos + d1 * r.rad, t.pos + d1 * outer_rad, t.pos + d2 * outer_rad, t.pos + d2 * r.rad, outline);
+            push_tri(t.pos, t.pos + d1 * r.rad, t.pos + d2 * r.rad, fill);
+        }
+
+        for(int i = 0; i < r.num_bonds; i++)
+        {
+            float bond_frac = (float)i / r.num_bonds;
+            float bond_angle = bond_frac * 2 * M_PI;
+
+            vec2f abs_dir = {cos(bond_angle), sin(bond_angle)};
+
+            abs_dir = abs_dir.rot(t.rotation);
+
+            ///2 wide, centred on the bond line
+            vec2f perp = {-abs_dir.y(), abs_dir.x()};
+
+            vec2f start = t.pos;
+            vec2f finish = t.pos + abs_dir * r.bond_length;
+
+            push_quad(start - perp, finish - perp, finish + perp, start + perp, sf::Color(255, 255, 255));
+        }
+    }
+
+    ///draws from a snapshot rather than the entity store, so this never touches sim state
+    ///alpha is how far we are between the snapshot's previous tick and its latest one
+    void render(sf::RenderWindow& win, const render_snapshot& snap, float alpha, vec2f tl, vec2f br)
+    {
+        view_tl = tl;
+        view_br = br;
+
+        particle_batch.clear();
+
+        for(const render_snapshot_entry& entry : snap.entries)
+        {
+            const render_component& r = entry.r;
+
+            transform_component t;
+            t.pos = entry.last_pos + (entry.pos - entry.last_pos) * alpha;
+            t.rotation = entry.last_rotation + (entry.rotation - entry.last_rotation) * alpha;
+
+            if(out_of_bounds(t.pos, r.extent()))
+                continue;
+
+            if(r.shape == render_shape::SPRITE)
+                render_sprite(win, r, t);
+
+            if(r.shape == render_shape::CIRCLE)
+                render_circle(win, r, t);
+
+            if(r.shape == render_shape::PARTICLE)
+                render_particle(win, r, t);
+        }
+
+        if(particle_batch.getVertexCount() > 0)
+            win.draw(particle_batch);
+    }
 };
 
 #endif // SYSTEMS_HPP_INCLUDED